@@ -0,0 +1,28 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/allocator.dir/buddy_allocator.cpp.o"
+  "CMakeFiles/allocator.dir/buddy_allocator.cpp.o.d"
+  "CMakeFiles/allocator.dir/huge_allocator.cpp.o"
+  "CMakeFiles/allocator.dir/huge_allocator.cpp.o.d"
+  "CMakeFiles/allocator.dir/large_allocator.cpp.o"
+  "CMakeFiles/allocator.dir/large_allocator.cpp.o.d"
+  "CMakeFiles/allocator.dir/main.cpp.o"
+  "CMakeFiles/allocator.dir/main.cpp.o.d"
+  "CMakeFiles/allocator.dir/monotonic_arena.cpp.o"
+  "CMakeFiles/allocator.dir/monotonic_arena.cpp.o.d"
+  "CMakeFiles/allocator.dir/os_memory.cpp.o"
+  "CMakeFiles/allocator.dir/os_memory.cpp.o.d"
+  "CMakeFiles/allocator.dir/persistent_heap.cpp.o"
+  "CMakeFiles/allocator.dir/persistent_heap.cpp.o.d"
+  "CMakeFiles/allocator.dir/shared_large_allocator.cpp.o"
+  "CMakeFiles/allocator.dir/shared_large_allocator.cpp.o.d"
+  "CMakeFiles/allocator.dir/striped_large_allocator.cpp.o"
+  "CMakeFiles/allocator.dir/striped_large_allocator.cpp.o.d"
+  "allocator"
+  "allocator.pdb"
+  "sample_size_classes.h"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/allocator.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
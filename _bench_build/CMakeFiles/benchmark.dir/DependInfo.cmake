@@ -0,0 +1,23 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/benchmark.cpp" "CMakeFiles/benchmark.dir/benchmark.cpp.o" "gcc" "CMakeFiles/benchmark.dir/benchmark.cpp.o.d"
+  "/root/repo/buddy_allocator.cpp" "CMakeFiles/benchmark.dir/buddy_allocator.cpp.o" "gcc" "CMakeFiles/benchmark.dir/buddy_allocator.cpp.o.d"
+  "/root/repo/large_allocator.cpp" "CMakeFiles/benchmark.dir/large_allocator.cpp.o" "gcc" "CMakeFiles/benchmark.dir/large_allocator.cpp.o.d"
+  "/root/repo/os_memory.cpp" "CMakeFiles/benchmark.dir/os_memory.cpp.o" "gcc" "CMakeFiles/benchmark.dir/os_memory.cpp.o.d"
+  "/root/repo/striped_large_allocator.cpp" "CMakeFiles/benchmark.dir/striped_large_allocator.cpp.o" "gcc" "CMakeFiles/benchmark.dir/striped_large_allocator.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
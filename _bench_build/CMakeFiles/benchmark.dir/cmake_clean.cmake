@@ -0,0 +1,19 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/benchmark.dir/benchmark.cpp.o"
+  "CMakeFiles/benchmark.dir/benchmark.cpp.o.d"
+  "CMakeFiles/benchmark.dir/buddy_allocator.cpp.o"
+  "CMakeFiles/benchmark.dir/buddy_allocator.cpp.o.d"
+  "CMakeFiles/benchmark.dir/large_allocator.cpp.o"
+  "CMakeFiles/benchmark.dir/large_allocator.cpp.o.d"
+  "CMakeFiles/benchmark.dir/os_memory.cpp.o"
+  "CMakeFiles/benchmark.dir/os_memory.cpp.o.d"
+  "CMakeFiles/benchmark.dir/striped_large_allocator.cpp.o"
+  "CMakeFiles/benchmark.dir/striped_large_allocator.cpp.o.d"
+  "benchmark"
+  "benchmark.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
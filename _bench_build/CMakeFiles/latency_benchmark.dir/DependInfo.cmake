@@ -0,0 +1,27 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/buddy_allocator.cpp" "CMakeFiles/latency_benchmark.dir/buddy_allocator.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/buddy_allocator.cpp.o.d"
+  "/root/repo/huge_allocator.cpp" "CMakeFiles/latency_benchmark.dir/huge_allocator.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/huge_allocator.cpp.o.d"
+  "/root/repo/large_allocator.cpp" "CMakeFiles/latency_benchmark.dir/large_allocator.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/large_allocator.cpp.o.d"
+  "/root/repo/latency_benchmark.cpp" "CMakeFiles/latency_benchmark.dir/latency_benchmark.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/latency_benchmark.cpp.o.d"
+  "/root/repo/monotonic_arena.cpp" "CMakeFiles/latency_benchmark.dir/monotonic_arena.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/monotonic_arena.cpp.o.d"
+  "/root/repo/os_memory.cpp" "CMakeFiles/latency_benchmark.dir/os_memory.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/os_memory.cpp.o.d"
+  "/root/repo/persistent_heap.cpp" "CMakeFiles/latency_benchmark.dir/persistent_heap.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/persistent_heap.cpp.o.d"
+  "/root/repo/shared_large_allocator.cpp" "CMakeFiles/latency_benchmark.dir/shared_large_allocator.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/shared_large_allocator.cpp.o.d"
+  "/root/repo/striped_large_allocator.cpp" "CMakeFiles/latency_benchmark.dir/striped_large_allocator.cpp.o" "gcc" "CMakeFiles/latency_benchmark.dir/striped_large_allocator.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
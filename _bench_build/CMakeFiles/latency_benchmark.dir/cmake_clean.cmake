@@ -0,0 +1,27 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/latency_benchmark.dir/buddy_allocator.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/buddy_allocator.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/huge_allocator.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/huge_allocator.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/large_allocator.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/large_allocator.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/latency_benchmark.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/latency_benchmark.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/monotonic_arena.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/monotonic_arena.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/os_memory.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/os_memory.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/persistent_heap.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/persistent_heap.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/shared_large_allocator.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/shared_large_allocator.cpp.o.d"
+  "CMakeFiles/latency_benchmark.dir/striped_large_allocator.cpp.o"
+  "CMakeFiles/latency_benchmark.dir/striped_large_allocator.cpp.o.d"
+  "latency_benchmark"
+  "latency_benchmark.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/latency_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
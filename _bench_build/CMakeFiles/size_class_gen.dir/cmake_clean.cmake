@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/size_class_gen.dir/size_class_gen.cpp.o"
+  "CMakeFiles/size_class_gen.dir/size_class_gen.cpp.o.d"
+  "size_class_gen"
+  "size_class_gen.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/size_class_gen.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -34,8 +34,8 @@ inline void* adjustForAlignedAlloc(void* p, std::size_t alignment)
     
     auto unaligned = static_cast<unsigned char*>(p);
     auto alignedP = roundUpPowerOfTwo(unaligned + 1, alignment);
-    // save the offset
-    alignedP[-1] = alignment == MaxAlign ? 0 : alignedP - unaligned;
+    // save the offset, only a full MaxAlign wraps around to 0
+    alignedP[-1] = static_cast<unsigned char>(alignedP - unaligned);
     return alignedP;
 }
     
@@ -44,7 +44,8 @@ inline void* getUnalignedAlloc(void* p)
     assert(p);
     
     auto unaligned = static_cast<unsigned char*>(p);
-    return unaligned - unaligned[-1];
+    // an offset of MaxAlign doesn't fit in the byte and was saved as 0
+    return unaligned - (unaligned[-1] ? unaligned[-1] : MaxAlign);
 }
     
 } // namespace memory
@@ -0,0 +1,347 @@
+//
+//  allocator_composition.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef ALLOCATOR_COMPOSITION_H
+#define ALLOCATOR_COMPOSITION_H
+
+#include "aligned_alloc.h"
+#include "memory_utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+// Building blocks to stack allocators into a custom one. Like BoundedAllocator
+// they wrap references to the allocators they are composed of, and every
+// decision is made on template parameters, so a call goes straight through to
+// the allocator serving it.
+//
+//     memory::SegregatedAllocator<16> small(16, 16);
+//     memory::LargeAllocator large(beg, end);
+//     memory::Segregator<256, memory::SegregatedAllocator<16>, memory::LargeAllocator> heap(small, large);
+
+namespace memory
+{
+
+namespace detail
+{
+
+template<typename Allocator, typename = void>
+struct HasAlignedMalloc : std::false_type {};
+
+template<typename Allocator>
+struct HasAlignedMalloc<Allocator, std::void_t<decltype(
+    std::declval<Allocator&>().malloc(std::size_t(), std::size_t()))>> : std::true_type {};
+
+template<typename Allocator, typename = void>
+struct HasOwns : std::false_type {};
+
+template<typename Allocator>
+struct HasOwns<Allocator, std::void_t<decltype(
+    std::declval<const Allocator&>().owns(static_cast<const void*>(nullptr)))>> : std::true_type {};
+
+template<typename Allocator, typename = void>
+struct HasUsableSize : std::false_type {};
+
+template<typename Allocator>
+struct HasUsableSize<Allocator, std::void_t<decltype(
+    std::declval<const Allocator&>().usableSize(static_cast<const void*>(nullptr)))>> : std::true_type {};
+
+template<typename Allocator, typename = void>
+struct HasFreeBatch : std::false_type {};
+
+template<typename Allocator>
+struct HasFreeBatch<Allocator, std::void_t<decltype(
+    std::declval<Allocator&>().freeBatch(static_cast<void* const*>(nullptr), std::size_t()))>> : std::true_type {};
+
+template<typename Allocator>
+constexpr bool hasAlignedMalloc = HasAlignedMalloc<Allocator>::value;
+template<typename Allocator>
+constexpr bool hasOwns = HasOwns<Allocator>::value;
+template<typename Allocator>
+constexpr bool hasUsableSize = HasUsableSize<Allocator>::value;
+template<typename Allocator>
+constexpr bool hasFreeBatch = HasFreeBatch<Allocator>::value;
+
+// allocators without an alignment parameter, e.g. SegregatedAllocator, align
+// their blocks on their own, put an AlignedAllocator on top to force more
+template<typename Allocator>
+void* allocate(Allocator& allocator, std::size_t size, std::size_t alignment)
+{
+    if constexpr (hasAlignedMalloc<Allocator>) {
+        return allocator.malloc(size, alignment);
+    } else {
+        return allocator.malloc(size);
+    }
+}
+
+// allocators without freeBatch, e.g. LargeAllocator, free the blocks one by one
+template<typename Allocator>
+void deallocateBatch(Allocator& allocator, void* const* blocks, std::size_t count)
+{
+    if constexpr (hasFreeBatch<Allocator>) {
+        allocator.freeBatch(blocks, count);
+    } else {
+        for (std::size_t i = 0; i < count; ++i) {
+            allocator.free(blocks[i]);
+        }
+    }
+}
+
+} // namespace detail
+
+// Requests up to Threshold bytes go to Small, the rest to Large. A block is
+// freed to Small if Small owns it, or else to Large if Large can tell.
+template<std::size_t Threshold, typename Small, typename Large>
+class Segregator
+{
+    static_assert(detail::hasOwns<Small> || detail::hasOwns<Large>,
+                  "one side has to tell its blocks apart");
+public:
+    Segregator(Small& small, Large& large)
+        : m_small(&small)
+        , m_large(&large)
+    {
+    }
+
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        return size <= Threshold ? detail::allocate(*m_small, size, alignment)
+                                 : detail::allocate(*m_large, size, alignment);
+    }
+
+    void free(void* p)
+    {
+        if (isSmall(p)) {
+            m_small->free(p);
+        } else {
+            m_large->free(p);
+        }
+    }
+
+    template<typename S = Small, typename L = Large,
+             typename = std::enable_if_t<detail::hasOwns<S> && detail::hasOwns<L>>>
+    bool owns(const void* p) const
+    {
+        return m_small->owns(p) || m_large->owns(p);
+    }
+
+    template<typename S = Small, typename L = Large,
+             typename = std::enable_if_t<detail::hasUsableSize<S> && detail::hasUsableSize<L>>>
+    std::size_t usableSize(const void* p) const
+    {
+        return isSmall(p) ? m_small->usableSize(p) : m_large->usableSize(p);
+    }
+private:
+    bool isSmall(const void* p) const
+    {
+        if constexpr (detail::hasOwns<Small>) {
+            return m_small->owns(p);
+        } else {
+            return !m_large->owns(p);
+        }
+    }
+
+    Small* m_small;
+    Large* m_large;
+};
+
+// Tries Primary first and Secondary when Primary returns nullptr. Primary has
+// to tell its blocks apart so frees go back to the right allocator.
+template<typename Primary, typename Secondary>
+class Fallback
+{
+    static_assert(detail::hasOwns<Primary>, "the primary allocator has to tell its blocks apart");
+public:
+    Fallback(Primary& primary, Secondary& secondary)
+        : m_primary(&primary)
+        , m_secondary(&secondary)
+    {
+    }
+
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        if (auto p = detail::allocate(*m_primary, size, alignment)) {
+            return p;
+        }
+        return detail::allocate(*m_secondary, size, alignment);
+    }
+
+    void free(void* p)
+    {
+        if (m_primary->owns(p)) {
+            m_primary->free(p);
+        } else {
+            m_secondary->free(p);
+        }
+    }
+
+    template<typename S = Secondary, typename = std::enable_if_t<detail::hasOwns<S>>>
+    bool owns(const void* p) const
+    {
+        return m_primary->owns(p) || m_secondary->owns(p);
+    }
+
+    template<typename P = Primary, typename S = Secondary,
+             typename = std::enable_if_t<detail::hasUsableSize<P> && detail::hasUsableSize<S>>>
+    std::size_t usableSize(const void* p) const
+    {
+        return m_primary->owns(p) ? m_primary->usableSize(p) : m_secondary->usableSize(p);
+    }
+private:
+    Primary* m_primary;
+    Secondary* m_secondary;
+};
+
+// Counts the calls going through to the allocator. With RecordSizes every
+// requested size is counted too, and writeHistogram() writes them out in the
+// input format of size_class_gen.
+template<typename Allocator, bool RecordSizes = false>
+class StatisticsAllocator
+{
+public:
+    StatisticsAllocator(Allocator& alloc)
+        : m_allocator(&alloc)
+    {
+    }
+
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        auto p = detail::allocate(*m_allocator, size, alignment);
+        if (!p) {
+            ++m_failedMallocs;
+            return nullptr;
+        }
+        ++m_mallocs;
+        m_bytesRequested += size;
+        if constexpr (detail::hasUsableSize<Allocator>) {
+            m_bytesInUse += m_allocator->usableSize(p);
+            m_peakBytesInUse = std::max(m_peakBytesInUse, m_bytesInUse);
+        }
+        if constexpr (RecordSizes) {
+            ++m_sizes[size];
+        }
+        return p;
+    }
+
+    void free(void* p)
+    {
+        if (!p) {
+            return;
+        }
+        ++m_frees;
+        if constexpr (detail::hasUsableSize<Allocator>) {
+            m_bytesInUse -= m_allocator->usableSize(p);
+        }
+        m_allocator->free(p);
+    }
+
+    template<typename A = Allocator, typename = std::enable_if_t<detail::hasOwns<A>>>
+    bool owns(const void* p) const
+    {
+        return m_allocator->owns(p);
+    }
+
+    template<typename A = Allocator, typename = std::enable_if_t<detail::hasUsableSize<A>>>
+    std::size_t usableSize(const void* p) const
+    {
+        return m_allocator->usableSize(p);
+    }
+
+    std::size_t mallocs() const { return m_mallocs; }
+    std::size_t failedMallocs() const { return m_failedMallocs; }
+    std::size_t frees() const { return m_frees; }
+    std::size_t bytesRequested() const { return m_bytesRequested; }
+    // the usable bytes of the blocks in use, only counted if the allocator reports them
+    std::size_t bytesInUse() const { return m_bytesInUse; }
+    std::size_t peakBytesInUse() const { return m_peakBytesInUse; }
+
+    // one `size count' line per requested size
+    template<bool R = RecordSizes, typename = std::enable_if_t<R>>
+    void writeHistogram(std::ostream& out) const
+    {
+        for (auto& entry : m_sizes) {
+            out << entry.first << ' ' << entry.second << '\n';
+        }
+    }
+private:
+    struct NoSizes {};
+
+    Allocator* m_allocator;
+    std::size_t m_mallocs = 0;
+    std::size_t m_failedMallocs = 0;
+    std::size_t m_frees = 0;
+    std::size_t m_bytesRequested = 0;
+    std::size_t m_bytesInUse = 0;
+    std::size_t m_peakBytesInUse = 0;
+    std::conditional_t<RecordSizes, std::map<std::size_t, std::size_t>, NoSizes> m_sizes;
+};
+
+// Aligns every block to at least Alignment. Allocators taking an alignment
+// are simply asked for it; for the others the block is padded and the
+// distance to the padded start is kept in the byte before the user memory.
+template<typename Allocator, std::size_t Alignment>
+class AlignedAllocator
+{
+    static_assert(isPowerOfTwo(Alignment));
+    static_assert(detail::hasAlignedMalloc<Allocator> || Alignment <= MaxAlign,
+                  "the padding offset has to fit in a byte");
+public:
+    AlignedAllocator(Allocator& alloc)
+        : m_allocator(&alloc)
+    {
+    }
+
+    void* malloc(std::size_t size, std::size_t alignment = Alignment)
+    {
+        alignment = std::max(alignment, Alignment);
+        if constexpr (detail::hasAlignedMalloc<Allocator>) {
+            return m_allocator->malloc(size, alignment);
+        } else {
+            assert(alignment <= MaxAlign);
+            auto p = m_allocator->malloc(calcAlignedAllocSize(size, alignment));
+            return p ? adjustForAlignedAlloc(p, alignment) : nullptr;
+        }
+    }
+
+    void free(void* p)
+    {
+        if constexpr (detail::hasAlignedMalloc<Allocator>) {
+            m_allocator->free(p);
+        } else if (p) {
+            m_allocator->free(getUnalignedAlloc(p));
+        }
+    }
+
+    template<typename A = Allocator, typename = std::enable_if_t<detail::hasOwns<A>>>
+    bool owns(const void* p) const
+    {
+        return m_allocator->owns(p);
+    }
+
+    template<typename A = Allocator, typename = std::enable_if_t<detail::hasUsableSize<A>>>
+    std::size_t usableSize(const void* p) const
+    {
+        if constexpr (detail::hasAlignedMalloc<Allocator>) {
+            return m_allocator->usableSize(p);
+        } else {
+            auto unaligned = getUnalignedAlloc(const_cast<void*>(p));
+            return m_allocator->usableSize(unaligned) - pointerDistanceTo(unaligned, p);
+        }
+    }
+private:
+    Allocator* m_allocator;
+};
+
+} // namespace memory
+
+#endif /* ALLOCATOR_COMPOSITION_H */
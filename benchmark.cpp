@@ -0,0 +1,713 @@
+//
+//  benchmark.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "segregated_allocator.h"
+#include "large_allocator.h"
+#include "striped_large_allocator.h"
+#include "object_pool.h"
+#include "lifetime_allocator.h"
+#include "buddy_allocator.h"
+#include "os_memory.h"
+#include "rb_tree.h"
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    
+using Clock = chrono::steady_clock;
+    
+double elapsedMs(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+    
+// Fills the allocator, frees most of the objects in random order and keeps
+// churning around a small live set. Reports how densely the surviving objects
+// are packed into pages.
+void benchmarkPageChurn()
+{
+    constexpr size_t numBins = 16;
+    constexpr size_t initialObjects = 200000;
+    constexpr size_t liveObjects = 20000;
+    constexpr size_t churnOps = 2000000;
+    
+    memory::SegregatedAllocator<numBins> allocator(16, 16);
+    mt19937 rng(42);
+    uniform_int_distribution<size_t> sizes(1, allocator.maxBinSize());
+    
+    vector<void*> live;
+    size_t liveBytes = 0;
+    auto allocate = [&] {
+        auto size = sizes(rng);
+        auto p = allocator.malloc(size);
+        live.push_back(p);
+        liveBytes += allocator.usableSize(p);
+    };
+    auto release = [&] {
+        auto index = uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+        liveBytes -= allocator.usableSize(live[index]);
+        allocator.free(live[index]);
+        live[index] = live.back();
+        live.pop_back();
+    };
+    
+    auto start = Clock::now();
+    for (size_t i = 0; i < initialObjects; ++i) {
+        allocate();
+    }
+    auto peakPages = allocator.pageCount();
+    while (live.size() > liveObjects) {
+        release();
+    }
+    auto drainedPages = allocator.pageCount();
+    for (size_t i = 0; i < churnOps; ++i) {
+        if (live.size() > liveObjects || (live.size() == liveObjects && rng() % 2)) {
+            release();
+        } else {
+            allocate();
+        }
+    }
+    auto ms = elapsedMs(start);
+    
+    auto pages = allocator.pageCount();
+    cout << "page churn: peak pages " << peakPages
+         << ", after drain " << drainedPages
+         << ", after churn " << pages
+         << ", utilization " << 100.0 * liveBytes / (pages * memory::vmPageSize()) << "%"
+         << ", " << ms << " ms\n";
+    
+    for (auto p : live) {
+        allocator.free(p);
+    }
+}
+
+// Chases pointers through a random cycle over the `nodes', each one the start
+// of a block, and returns the nanoseconds per hop.
+double chase(vector<char*>& nodes, mt19937& rng)
+{
+    constexpr size_t hops = 20000000;
+    
+    shuffle(nodes.begin(), nodes.end(), rng);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        *reinterpret_cast<char**>(nodes[i]) = nodes[(i + 1) % nodes.size()];
+    }
+    auto p = nodes[0];
+    auto start = Clock::now();
+    for (size_t i = 0; i < hops; ++i) {
+        p = *reinterpret_cast<char**>(p);
+    }
+    auto ms = elapsedMs(start);
+    // keep the loop from being optimized away
+    if (!p) {
+        cout << "";
+    }
+    return ms * 1e6 / hops;
+}
+    
+// Walks the first block of many pages of one bin. Without coloring these
+// blocks would all sit at the same page offset and map to the same cache sets,
+// so the walk is repeated over the same pages with every block moved back to
+// the offset of the uncolored first block.
+void benchmarkCacheColoring()
+{
+    constexpr size_t blockSize = 1000;
+    constexpr size_t numPages = 512;
+    
+    memory::SegregatedAllocator<1> allocator(blockSize, 8);
+    auto pageSize = memory::vmPageSize();
+    vector<void*> blocks;
+    vector<char*> firstBlocks;
+    while (allocator.pageCount() < numPages) {
+        auto p = static_cast<char*>(allocator.malloc(blockSize));
+        blocks.push_back(p);
+        // blocks are carved from the front, the first of a page is the lowest
+        auto page = memory::roundDownPowerOfTwo(p, pageSize);
+        if (firstBlocks.empty() || memory::roundDownPowerOfTwo(firstBlocks.back(), pageSize) != page) {
+            firstBlocks.push_back(p);
+        }
+    }
+    
+    size_t uncoloredOffset = pageSize;
+    size_t numColors = 0;
+    for (auto p : firstBlocks) {
+        uncoloredOffset = min(uncoloredOffset, static_cast<size_t>(p - memory::roundDownPowerOfTwo(p, pageSize)));
+    }
+    vector<char*> uncolored;
+    for (auto p : firstBlocks) {
+        auto offset = static_cast<size_t>(p - memory::roundDownPowerOfTwo(p, pageSize));
+        numColors = max(numColors, (offset - uncoloredOffset) / memory::cacheLineSize + 1);
+        uncolored.push_back(p - offset + uncoloredOffset);
+    }
+    
+    mt19937 rng(42);
+    auto coloredNs = chase(firstBlocks, rng);
+    auto uncoloredNs = chase(uncolored, rng);
+    cout << "cache coloring: " << firstBlocks.size() << " pages, " << numColors << " colors, "
+         << "uncolored " << uncoloredNs << " ns/hop, colored " << coloredNs << " ns/hop\n";
+    
+    for (auto p : blocks) {
+        allocator.free(p);
+    }
+}
+
+// Creates and destroys entities in random order through an ObjectPool and
+// through new/delete, around a live set which fits in the cache and one which
+// doesn't.
+void benchmarkObjectPool()
+{
+    struct Entity
+    {
+        float position[3];
+        float velocity[3];
+        int id;
+    };
+    constexpr size_t churnOps = 5000000;
+    
+    auto run = [](size_t liveObjects, auto create, auto destroy) {
+        mt19937 rng(42);
+        vector<Entity*> live;
+        for (size_t i = 0; i < liveObjects; ++i) {
+            live.push_back(create());
+        }
+        auto start = Clock::now();
+        for (size_t i = 0; i < churnOps; ++i) {
+            auto& slot = live[rng() % live.size()];
+            destroy(slot);
+            slot = create();
+        }
+        auto ms = elapsedMs(start);
+        for (auto p : live) {
+            destroy(p);
+        }
+        return ms;
+    };
+    
+    for (size_t liveObjects : { 1000, 100000 }) {
+        memory::ObjectPool<Entity> pool;
+        auto poolMs = run(liveObjects, [&] { return pool.create(); }, [&](Entity* p) { pool.destroy(p); });
+        auto newMs = run(liveObjects, [] { return new Entity(); }, [](Entity* p) { delete p; });
+        cout << "object pool, " << liveObjects << " live: " << poolMs << " ms, new/delete " << newMs << " ms\n";
+    }
+}
+
+// Churns power of two buffers between 4 KiB and 256 KiB through a
+// BuddyAllocator and through a LargeAllocator over a region of the same size.
+// Only the buddy blocks come aligned to their size.
+void benchmarkBuddy()
+{
+    constexpr size_t regionSize = 1024 * 1024 * 1024;
+    constexpr size_t liveBuffers = 1024;
+    constexpr size_t churnOps = 2000000;
+    
+    auto run = [](auto&& allocator) {
+        mt19937 rng(42);
+        uniform_int_distribution<int> shifts(12, 18);
+        vector<void*> live(liveBuffers);
+        auto start = Clock::now();
+        for (size_t i = 0; i < churnOps; ++i) {
+            auto& slot = live[rng() % live.size()];
+            allocator.free(slot);
+            slot = allocator.malloc(size_t(1) << shifts(rng));
+        }
+        auto ms = elapsedMs(start);
+        for (auto p : live) {
+            allocator.free(p);
+        }
+        return ms;
+    };
+    
+    memory::BuddyAllocator buddy(regionSize);
+    auto buddyMs = run(buddy);
+    auto buf = static_cast<char*>(memory::vmAllocate(regionSize));
+    auto largeMs = run(memory::LargeAllocator(buf, buf + regionSize));
+    memory::vmDeallocate(buf, regionSize);
+    cout << "buddy: " << buddyMs << " ms, large allocator " << largeMs << " ms\n";
+}
+
+// Requests handle short lived buffers while now and then a block is kept for
+// good. Once the requests are done, the pages the kept blocks are spread over
+// are counted with every block in the same LargeAllocator arena and with the
+// kept blocks routed to an arena of their own by a lifetime hint.
+void benchmarkLifetime()
+{
+    constexpr size_t arenaSize = 256 * 1024 * 1024;
+    constexpr size_t requests = 2000;
+    constexpr size_t buffersPerRequest = 64;
+    constexpr size_t keepEvery = 97;
+    
+    auto run = [](auto malloc, auto free) {
+        mt19937 rng(42);
+        // connection state next to request buffers
+        uniform_int_distribution<size_t> keptSizes(64, 512);
+        uniform_int_distribution<size_t> scratchSizes(1024, 64 * 1024);
+        vector<void*> kept;
+        vector<void*> scratch;
+        size_t n = 0;
+        for (size_t r = 0; r < requests; ++r) {
+            for (size_t i = 0; i < buffersPerRequest; ++i) {
+                if (++n % keepEvery == 0) {
+                    kept.push_back(malloc(keptSizes(rng), memory::Lifetime::longLived));
+                } else {
+                    scratch.push_back(malloc(scratchSizes(rng), memory::Lifetime::shortLived));
+                }
+            }
+            // the requests overlap, half of the scratch lives on into the next one
+            shuffle(scratch.begin(), scratch.end(), rng);
+            for (size_t i = scratch.size() / 2; i < scratch.size(); ++i) {
+                free(scratch[i], memory::Lifetime::shortLived);
+            }
+            scratch.resize(scratch.size() / 2);
+        }
+        for (auto p : scratch) {
+            free(p, memory::Lifetime::shortLived);
+        }
+        
+        vector<uintptr_t> pages;
+        for (auto p : kept) {
+            pages.push_back(reinterpret_cast<uintptr_t>(p) / memory::vmPageSize());
+        }
+        sort(pages.begin(), pages.end());
+        auto first = pages.front();
+        auto span = pages.back() - first + 1;
+        auto touched = unique(pages.begin(), pages.end()) - pages.begin();
+        for (auto p : kept) {
+            free(p, memory::Lifetime::longLived);
+        }
+        return make_pair(static_cast<size_t>(touched), static_cast<size_t>(span));
+    };
+    
+    auto buf = static_cast<char*>(memory::vmAllocate(2 * arenaSize));
+    memory::LargeAllocator shared(buf, buf + 2 * arenaSize);
+    auto mixed = run([&](size_t size, memory::Lifetime) {
+        return shared.malloc(size);
+    }, [&](void* p, memory::Lifetime) {
+        shared.free(p);
+    });
+    
+    memory::LargeAllocator shortLived(buf, buf + arenaSize);
+    memory::LargeAllocator longLived(buf + arenaSize, buf + 2 * arenaSize);
+    memory::LifetimeAllocator<memory::LargeAllocator> lifetimes(shortLived, longLived, longLived);
+    auto split = run([&](size_t size, memory::Lifetime hint) {
+        return lifetimes.malloc(size, hint);
+    }, [&](void* p, memory::Lifetime hint) {
+        lifetimes.free(p, hint);
+    });
+    memory::vmDeallocate(buf, 2 * arenaSize);
+    
+    cout << "lifetime: kept blocks touch " << mixed.first << " pages spread over " << mixed.second
+         << " mixed, " << split.first << " pages over " << split.second << " by lifetime\n";
+}
+
+// The same churn on a free block index alone: a free inserts the block, a
+// malloc takes the first one of at least its size. Returns ns per pair.
+template<typename Base, size_t numSizes>
+double duplicateSizesIndexChurn(const size_t (&sizes)[numSizes], size_t numBlocks, size_t churnOps)
+{
+    struct Node : Base
+    {
+        size_t size;
+    };
+    
+    struct SizeLess
+    {
+        using is_transparent = void;
+        
+        bool operator()(const Node& a, const Node& b) const { return a.size < b.size; }
+        bool operator()(const Node& a, size_t size) const { return a.size < size; }
+        bool operator()(size_t size, const Node& b) const { return size < b.size; }
+    };
+    
+    vector<Node> nodes(numBlocks);
+    RbTree<Node, SizeLess> index;
+    vector<Node*> live;
+    for (size_t i = 0; i < numBlocks; ++i) {
+        nodes[i].size = sizes[i % numSizes];
+        if (i % 2) {
+            index.insert(nodes[i]);
+        } else {
+            live.push_back(&nodes[i]);
+        }
+    }
+    
+    mt19937 rng(42);
+    auto start = Clock::now();
+    for (size_t i = 0; i < churnOps; ++i) {
+        auto& slot = live[rng() % live.size()];
+        index.insert(*slot);
+        auto it = index.lowerBound(sizes[rng() % numSizes]);
+        if (it == index.end()) {
+            it = index.begin();
+        }
+        slot = const_cast<Node*>(&*it);
+        index.remove(*slot);
+    }
+    auto ms = elapsedMs(start);
+    
+    while (!index.empty()) {
+        index.remove(*index.begin());
+    }
+    return ms * 1e6 / churnOps;
+}
+
+// Fixed size churn leaves many free blocks of the same few sizes in a
+// LargeAllocator: every other block of a run is freed so none of them can be
+// coalesced, then blocks are freed and allocated again at random. The index
+// churn is timed on its own with and without the duplicates chained.
+void benchmarkDuplicateSizes()
+{
+    constexpr size_t arenaSize = 256 * 1024 * 1024;
+    constexpr size_t numBlocks = 200000;
+    constexpr size_t churnOps = 2000000;
+    const size_t sizes[] = { 64, 128, 256, 512 };
+    
+    auto buf = static_cast<char*>(memory::vmAllocate(arenaSize));
+    {
+        memory::LargeAllocator allocator(buf, buf + arenaSize);
+        mt19937 rng(42);
+        vector<void*> blocks;
+        for (size_t i = 0; i < numBlocks; ++i) {
+            blocks.push_back(allocator.malloc(sizes[i % size(sizes)]));
+        }
+        vector<void*> live;
+        for (size_t i = 0; i < numBlocks; ++i) {
+            if (i % 2) {
+                allocator.free(blocks[i]);
+            } else {
+                live.push_back(blocks[i]);
+            }
+        }
+        
+        auto start = Clock::now();
+        for (size_t i = 0; i < churnOps; ++i) {
+            auto& slot = live[rng() % live.size()];
+            allocator.free(slot);
+            slot = allocator.malloc(sizes[rng() % size(sizes)]);
+        }
+        auto ms = elapsedMs(start);
+        cout << "duplicate sizes: " << ms * 1e6 / churnOps << " ns per free/malloc pair\n";
+        
+        for (auto p : live) {
+            allocator.free(p);
+        }
+    }
+    memory::vmDeallocate(buf, arenaSize);
+    
+    auto unchained = duplicateSizesIndexChurn<RbTreeNode>(sizes, numBlocks, churnOps);
+    auto chained = duplicateSizesIndexChurn<RbTreeChainNode>(sizes, numBlocks, churnOps);
+    cout << "duplicate sizes, index alone: " << unchained << " ns per insert/remove pair unchained, "
+         << chained << " ns chained\n";
+}
+
+// Leaves a large index of free blocks, every other one of a run of small
+// blocks, and churns through it, with plain and with compressed block links.
+// Reports the time per pair and how far the blocks reach into the arena.
+template<typename Allocator>
+void runCompressedLinks(const char* name)
+{
+    constexpr size_t arenaSize = 1024 * 1024 * 1024;
+    constexpr size_t numBlocks = 2000000;
+    constexpr size_t churnOps = 2000000;
+    
+    auto buf = static_cast<char*>(memory::vmAllocate(arenaSize));
+    {
+        Allocator allocator(buf, buf + arenaSize);
+        mt19937 rng(42);
+        vector<void*> blocks;
+        char* highWater = buf;
+        for (size_t i = 0; i < numBlocks; ++i) {
+            auto size = 16 + rng() % 256;
+            auto p = static_cast<char*>(allocator.malloc(size));
+            blocks.push_back(p);
+            highWater = max(highWater, p + size);
+        }
+        vector<void*> live;
+        for (size_t i = 0; i < numBlocks; ++i) {
+            if (i % 2) {
+                allocator.free(blocks[i]);
+            } else {
+                live.push_back(blocks[i]);
+            }
+        }
+        
+        auto start = Clock::now();
+        for (size_t i = 0; i < churnOps; ++i) {
+            auto& slot = live[rng() % live.size()];
+            allocator.free(slot);
+            slot = allocator.malloc(16 + rng() % 256);
+        }
+        auto ms = elapsedMs(start);
+        cout << "compressed links: " << name << " " << ms * 1e6 / churnOps << " ns per free/malloc pair, "
+             << (highWater - buf) / 1024 << " KiB for " << numBlocks << " blocks\n";
+        
+        for (auto p : live) {
+            allocator.free(p);
+        }
+    }
+    memory::vmDeallocate(buf, arenaSize);
+}
+
+void benchmarkCompressedLinks()
+{
+    runCompressedLinks<memory::LargeAllocator>("pointers");
+    runCompressedLinks<memory::CompressedLargeAllocator>("offsets");
+}
+
+// Random sized blocks are allocated and freed at random around a live set,
+// reporting how far into the arena the blocks reach with each fit policy.
+void benchmarkFitPolicy()
+{
+    constexpr size_t arenaSize = 1024 * 1024 * 1024;
+    constexpr size_t liveBlocks = 20000;
+    constexpr size_t churnOps = 2000000;
+    
+    auto buf = static_cast<char*>(memory::vmAllocate(arenaSize));
+    for (auto policy : { memory::LargeAllocator::FitPolicy::bestFit,
+                         memory::LargeAllocator::FitPolicy::addressFirstFit }) {
+        memory::LargeAllocator allocator(buf, buf + arenaSize, 0, false, policy);
+        mt19937 rng(42);
+        // mostly small blocks with a long tail
+        lognormal_distribution<double> sizes(7, 1.5);
+        vector<pair<char*, size_t>> live;
+        size_t liveBytes = 0;
+        size_t peakLiveBytes = 0;
+        char* highWater = buf;
+        auto allocate = [&] {
+            auto size = min<size_t>(static_cast<size_t>(sizes(rng)) + 1, 4 * 1024 * 1024);
+            auto p = static_cast<char*>(allocator.malloc(size));
+            live.emplace_back(p, size);
+            liveBytes += size;
+            peakLiveBytes = max(peakLiveBytes, liveBytes);
+            highWater = max(highWater, p + size);
+        };
+        for (size_t i = 0; i < liveBlocks; ++i) {
+            allocate();
+        }
+        auto start = Clock::now();
+        for (size_t i = 0; i < churnOps; ++i) {
+            auto index = rng() % live.size();
+            allocator.free(live[index].first);
+            liveBytes -= live[index].second;
+            live[index] = live.back();
+            live.pop_back();
+            allocate();
+        }
+        auto ms = elapsedMs(start);
+        for (auto& block : live) {
+            allocator.free(block.first);
+        }
+        
+        cout << (policy == memory::LargeAllocator::FitPolicy::bestFit ? "best fit" : "address first fit")
+             << ": arena used " << (highWater - buf) / 1024 << " KiB for a peak of "
+             << peakLiveBytes / 1024 << " KiB live, " << ms << " ms\n";
+    }
+    memory::vmDeallocate(buf, arenaSize);
+}
+
+// Builds a tree of free block sized nodes from sorted nodes, inserting them
+// one by one against building it in one go, then splits and joins it again.
+void benchmarkTreeBuild()
+{
+    struct Node : RbTreeNode
+    {
+        size_t size;
+        
+        bool operator <(const Node& rhs) const
+        {
+            return size < rhs.size;
+        }
+    };
+    
+    constexpr size_t numNodes = 1000000;
+    vector<Node> nodes(numNodes);
+    mt19937 rng(42);
+    for (auto& node : nodes) {
+        node.size = rng();
+    }
+    sort(nodes.begin(), nodes.end());
+    
+    RbTree<Node> tree;
+    auto start = Clock::now();
+    for (auto& node : nodes) {
+        tree.insert(node);
+    }
+    auto insertMs = elapsedMs(start);
+    for (auto& node : nodes) {
+        tree.remove(node);
+    }
+    
+    start = Clock::now();
+    tree.buildFromSorted(nodes.begin(), nodes.end());
+    auto buildMs = elapsedMs(start);
+    
+    RbTree<Node> upper;
+    start = Clock::now();
+    tree.split(nodes[numNodes / 2], upper);
+    tree.join(upper);
+    auto splitJoinMs = elapsedMs(start);
+    
+    cout << "tree build: " << numNodes << " nodes inserted in " << insertMs << " ms, built in "
+         << buildMs << " ms, split and joined in " << splitJoinMs << " ms\n";
+}
+
+// Looks up a rising run of sizes in a tree of free block sized nodes, like a
+// caller walking the size classes, from the root and from the last result.
+void benchmarkTreeLookup()
+{
+    struct Node : RbTreeNode
+    {
+        size_t size;
+    };
+    
+    struct SizeLess
+    {
+        using is_transparent = void;
+        
+        bool operator()(const Node& a, const Node& b) const { return a.size < b.size; }
+        bool operator()(const Node& a, size_t size) const { return a.size < size; }
+        bool operator()(size_t size, const Node& b) const { return size < b.size; }
+    };
+    
+    constexpr size_t numNodes = 1000000;
+    constexpr size_t numLookups = 10000000;
+    vector<Node> nodes(numNodes);
+    mt19937_64 rng(42);
+    for (auto& node : nodes) {
+        node.size = rng() % (numNodes * 64);
+    }
+    sort(nodes.begin(), nodes.end(), SizeLess());
+    RbTree<Node, SizeLess> tree;
+    tree.buildFromSorted(nodes.begin(), nodes.end());
+    
+    size_t found = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < numLookups; ++i) {
+        found += tree.lowerBound(i * 6) != tree.end();
+    }
+    auto rootMs = elapsedMs(start);
+    
+    start = Clock::now();
+    auto hint = tree.begin();
+    for (size_t i = 0; i < numLookups; ++i) {
+        hint = tree.lowerBound(i * 6, hint);
+        found += hint != tree.end();
+    }
+    auto hintMs = elapsedMs(start);
+    
+    cout << "tree lookup: " << rootMs * 1e6 / numLookups << " ns from the root, "
+         << hintMs * 1e6 / numLookups << " ns from a hint (" << found << " found)\n";
+}
+
+// Each thread keeps a window of 4 KiB - 1 MiB blocks, replacing the oldest one
+// on every step, so every operation goes to the allocator.
+template<typename Malloc, typename Free>
+double runLargeWorkers(size_t numThreads, Malloc&& malloc, Free&& free)
+{
+    constexpr size_t opsPerThread = 200000;
+    constexpr size_t window = 64;
+    
+    auto start = Clock::now();
+    vector<thread> threads;
+    for (size_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t] {
+            mt19937 rng(static_cast<unsigned>(t));
+            uniform_int_distribution<size_t> sizes(4 * 1024, 1024 * 1024);
+            void* blocks[window] = {};
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                auto& slot = blocks[i % window];
+                free(slot);
+                slot = malloc(sizes(rng));
+                // touch the block like a caller would
+                static_cast<char*>(slot)[0] = 1;
+            }
+            for (auto p : blocks) {
+                free(p);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto ms = elapsedMs(start);
+    return numThreads * opsPerThread / ms / 1000;
+}
+    
+// Throughput of one mutex guarded LargeAllocator against one arena per core.
+void benchmarkStripedLarge()
+{
+    auto cores = max<size_t>(1, thread::hardware_concurrency());
+    constexpr size_t arenaSize = 256 * 1024 * 1024;
+    
+    for (size_t threads = 1; threads <= cores; threads *= 2) {
+        auto buf = static_cast<char*>(memory::vmAllocate(arenaSize * cores));
+        memory::LargeAllocator single(buf, buf + arenaSize * cores);
+        mutex singleMutex;
+        auto locked = runLargeWorkers(threads, [&](size_t size) {
+            lock_guard<mutex> lock(singleMutex);
+            return single.malloc(size);
+        }, [&](void* p) {
+            lock_guard<mutex> lock(singleMutex);
+            single.free(p);
+        });
+        memory::vmDeallocate(buf, arenaSize * cores);
+        
+        memory::StripedLargeAllocator striped(cores, arenaSize);
+        auto stripedOps = runLargeWorkers(threads, [&](size_t size) {
+            return striped.malloc(size);
+        }, [&](void* p) {
+            striped.free(p);
+        });
+        
+        cout << "striped large, " << threads << " threads: single lock " << locked
+             << " Mops/s, " << cores << " arenas " << stripedOps << " Mops/s\n";
+    }
+}
+
+struct Benchmark
+{
+    const char* name;
+    void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+    { "page_churn", benchmarkPageChurn },
+    { "striped_large", benchmarkStripedLarge },
+    { "cache_coloring", benchmarkCacheColoring },
+    { "object_pool", benchmarkObjectPool },
+    { "buddy", benchmarkBuddy },
+    { "lifetime", benchmarkLifetime },
+    { "duplicate_sizes", benchmarkDuplicateSizes },
+    { "fit_policy", benchmarkFitPolicy },
+    { "compressed_links", benchmarkCompressedLinks },
+    { "tree_build", benchmarkTreeBuild },
+    { "tree_lookup", benchmarkTreeLookup },
+};
+    
+} // namespace
+
+// runs every benchmark, or only the ones named on the command line
+int main(int argc, const char* argv[])
+{
+    for (auto& b : benchmarks) {
+        if (argc == 1 || find_if(argv + 1, argv + argc, [&](const char* arg) {
+                return b.name == string(arg);
+            }) != argv + argc) {
+            b.run();
+        }
+    }
+}
@@ -0,0 +1,283 @@
+//
+//  bitmap_slab.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef BITMAP_SLAB_H
+#define BITMAP_SLAB_H
+
+#include "memory_utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace memory
+{
+    
+// Fixed size blocks tracked by an occupancy bitmap placed at the start of the
+// range. Unlike FreeList, freeing never writes to the block itself and the
+// lowest free block is always handed out first, so allocation order stays
+// sequential and the blocks beyond the high water mark are never touched.
+class BitmapSlab
+{
+    using Word = std::uint64_t;
+    static constexpr std::size_t bitsPerWord = sizeof(Word) * 8;
+public:
+    static constexpr std::size_t minBlockSize = alignof(std::uint64_t);
+    
+    BitmapSlab() = default;
+    
+    // `zeroed' tells that the range is known to be filled with zeros
+    BitmapSlab(void* beg, void* end, std::size_t size, bool zeroed = false)
+    {
+        init(static_cast<char*>(beg), static_cast<char*>(end), size, zeroed);
+    }
+    
+    BitmapSlab(const BitmapSlab&) = delete;
+    BitmapSlab(BitmapSlab&& rhs)
+    {
+        swap(rhs);
+    }
+    
+    BitmapSlab& operator =(const BitmapSlab&) = delete;
+    BitmapSlab& operator =(BitmapSlab&& rhs)
+    {
+        swap(rhs);
+        return *this;
+    }
+    
+    void swap(BitmapSlab& rhs)
+    {
+        std::swap(m_bitmap, rhs.m_bitmap);
+        std::swap(m_blocks, rhs.m_blocks);
+        std::swap(m_blockSize, rhs.m_blockSize);
+        std::swap(m_reciprocal, rhs.m_reciprocal);
+        std::swap(m_capacity, rhs.m_capacity);
+        std::swap(m_numWords, rhs.m_numWords);
+        std::swap(m_hint, rhs.m_hint);
+        std::swap(m_highWater, rhs.m_highWater);
+        std::swap(m_zeroed, rhs.m_zeroed);
+    }
+    
+    bool empty() const { return m_hint == m_numWords; }
+    
+    std::size_t blockSize() const { return m_blockSize; }
+    // the number of blocks the range was split into
+    std::size_t capacity() const { return m_capacity; }
+    
+    void* malloc()
+    {
+        if (empty()) {
+            return nullptr;
+        }
+        
+        auto& word = m_bitmap[m_hint];
+        auto index = m_hint * bitsPerWord + countTrailingZeros(word);
+        // clear the lowest set bit
+        word &= word - 1;
+        if (!word) {
+            advanceHint();
+        }
+        m_highWater = std::max(m_highWater, index + 1);
+        return blockAt(index);
+    }
+    
+    void* calloc()
+    {
+        if (empty()) {
+            return nullptr;
+        }
+        
+        // blocks are handed out lowest first, nothing at or above the high water mark has been used
+        bool dirty = !m_zeroed || m_hint * bitsPerWord + countTrailingZeros(m_bitmap[m_hint]) < m_highWater;
+        auto p = malloc();
+        if (dirty) {
+            std::memset(p, 0, m_blockSize);
+        }
+        return p;
+    }
+    
+    // allocate up to `count' blocks at once, returns the number of blocks allocated
+    std::size_t mallocBatch(void** out, std::size_t count)
+    {
+        std::size_t n = 0;
+        while (n < count && !empty()) {
+            auto& word = m_bitmap[m_hint];
+            auto base = m_hint * bitsPerWord;
+            // take the whole word if possible
+            if (popCount(word) <= count - n) {
+                for (auto bits = word; bits; bits &= bits - 1) {
+                    out[n++] = blockAt(base + countTrailingZeros(bits));
+                }
+                m_highWater = std::max(m_highWater, base + bitsPerWord - countLeadingZeros(word));
+                word = 0;
+                advanceHint();
+            } else {
+                while (n < count) {
+                    auto index = base + countTrailingZeros(word);
+                    word &= word - 1;
+                    out[n++] = blockAt(index);
+                    m_highWater = std::max(m_highWater, index + 1);
+                }
+            }
+        }
+        return n;
+    }
+    
+    void free(void* p)
+    {
+        if (p) {
+            auto index = indexOf(p);
+            auto wordIndex = index / bitsPerWord;
+            assert(!(m_bitmap[wordIndex] & (Word(1) << index % bitsPerWord)));
+            m_bitmap[wordIndex] |= Word(1) << index % bitsPerWord;
+            m_hint = std::min(m_hint, wordIndex);
+        }
+    }
+    
+    // whether a block is in use in both slabs, the slabs must have the same layout
+    bool overlaps(const BitmapSlab& rhs) const
+    {
+        assert(m_numWords == rhs.m_numWords && m_blockSize == rhs.m_blockSize);
+        for (std::size_t i = 0; i < m_numWords; ++i) {
+            auto valid = validBits(i);
+            if (((m_bitmap[i] | rhs.m_bitmap[i]) & valid) != valid) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // copy the blocks in use of `rhs' to the same positions of this slab and
+    // take them over, the slabs must not overlap
+    void absorb(const BitmapSlab& rhs)
+    {
+        assert(!overlaps(rhs));
+        assert(pointerDistanceTo(m_bitmap, m_blocks) == pointerDistanceTo(rhs.m_bitmap, rhs.m_blocks));
+        for (std::size_t i = 0; i < m_numWords; ++i) {
+            for (auto used = ~rhs.m_bitmap[i] & validBits(i); used; used &= used - 1) {
+                auto index = i * bitsPerWord + countTrailingZeros(used);
+                std::memcpy(blockAt(index), rhs.blockAt(index), m_blockSize);
+            }
+            m_bitmap[i] &= rhs.m_bitmap[i];
+        }
+        m_highWater = std::max(m_highWater, rhs.m_highWater);
+        m_hint = 0;
+        advanceHint();
+    }
+    
+    // undo absorb(), the blocks in use of `rhs' are free in this slab again
+    void disown(const BitmapSlab& rhs)
+    {
+        for (std::size_t i = 0; i < m_numWords; ++i) {
+            m_bitmap[i] |= ~rhs.m_bitmap[i] & validBits(i);
+        }
+        m_hint = 0;
+        advanceHint();
+    }
+    
+    std::size_t usableSize(const void* p) const
+    {
+        assert(p);
+        return m_blockSize;
+    }
+    
+    static std::size_t goodSize(std::size_t n)
+    {
+        return adjustBlockSize(n);
+    }
+    
+    static std::size_t adjustBlockSize(std::size_t n)
+    {
+        return roundUp(n, minBlockSize);
+    }
+    
+    // the number of blocks of `size' a slab over an aligned range of `bytes' holds
+    static std::size_t capacityFor(std::size_t bytes, std::size_t size)
+    {
+        size = roundUpPowerOfTwo(size, minBlockSize);
+        // each block costs its size plus one bit of the bitmap
+        auto numBlocks = bytes * 8 / (size * 8 + 1);
+        while (numBlocks &&
+               roundUp(numBlocks, bitsPerWord) / 8 + numBlocks * size > bytes) {
+            --numBlocks;
+        }
+        return numBlocks;
+    }
+private:
+    void init(char* beg, char* end, std::size_t size, bool zeroed)
+    {
+        assert(beg && end && beg < end);
+        assert(size >= minBlockSize);
+        
+        beg = align(beg, alignof(Word));
+        assert(beg <= end);
+        auto numBlocks = capacityFor(end - beg, size);
+        size = roundUpPowerOfTwo(size, minBlockSize);
+        
+        m_bitmap = alignedCast<Word*>(beg);
+        m_numWords = roundUp(numBlocks, bitsPerWord) / bitsPerWord;
+        m_blocks = beg + m_numWords * sizeof(Word);
+        m_blockSize = size;
+        m_capacity = numBlocks;
+        // ceil(2^32 / size), exact for dividing multiples of size below 4 GiB
+        m_reciprocal = ((std::uint64_t(1) << 32) + size - 1) / size;
+        m_highWater = 0;
+        m_zeroed = zeroed;
+        
+        std::fill(m_bitmap, m_bitmap + m_numWords, ~Word(0));
+        // the tail bits don't map to any block
+        if (auto tail = numBlocks % bitsPerWord) {
+            m_bitmap[m_numWords - 1] = (Word(1) << tail) - 1;
+        }
+        m_hint = 0;
+    }
+    
+    // the bits of the word which map to blocks
+    Word validBits(std::size_t wordIndex) const
+    {
+        auto tail = m_capacity % bitsPerWord;
+        return wordIndex + 1 < m_numWords || !tail ? ~Word(0) : (Word(1) << tail) - 1;
+    }
+    
+    void advanceHint()
+    {
+        while (m_hint < m_numWords && !m_bitmap[m_hint]) {
+            ++m_hint;
+        }
+    }
+    
+    void* blockAt(std::size_t index) const
+    {
+        return m_blocks + index * m_blockSize;
+    }
+    
+    std::size_t indexOf(const void* p) const
+    {
+        auto offset = static_cast<std::uint64_t>(pointerDistanceTo(m_blocks, p));
+        assert(offset % m_blockSize == 0);
+        return static_cast<std::size_t>(offset * m_reciprocal >> 32);
+    }
+    
+    // set bits mark free blocks
+    Word* m_bitmap = nullptr;
+    char* m_blocks = nullptr;
+    std::size_t m_blockSize = 0;
+    std::uint64_t m_reciprocal = 0;
+    std::size_t m_capacity = 0;
+    std::size_t m_numWords = 0;
+    // no word before this one has a free block
+    std::size_t m_hint = 0;
+    // blocks at or above this index have never been handed out
+    std::size_t m_highWater = 0;
+    bool m_zeroed = false;
+};
+
+} // namespace memory
+
+#endif /* BITMAP_SLAB_H */
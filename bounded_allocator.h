@@ -60,6 +60,18 @@ public:
             m_allocator->free(user - header.offset);
         }
     }
+    
+    // the tag sits right after the user memory, so nothing beyond the requested size is usable
+    std::size_t usableSize(const void* p) const
+    {
+        assert(p);
+        return alignedCast<const Header*>(p)[-1].userSize;
+    }
+    
+    std::size_t goodSize(std::size_t size) const
+    {
+        return size;
+    }
 private:
     Allocator* m_allocator;
 };
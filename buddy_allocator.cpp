@@ -0,0 +1,191 @@
+//
+//  buddy_allocator.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "buddy_allocator.h"
+#include "memory_utils.h"
+#include "os_memory.h"
+#include "trace_path.h"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace memory
+{
+    
+namespace
+{
+    
+std::size_t log2Ceil(std::size_t n)
+{
+    return n > 1 ? sizeof(std::uint64_t) * 8 - countLeadingZeros(n - 1) : 0;
+}
+    
+} // unnamed namespace
+    
+BuddyAllocator::BuddyAllocator(std::size_t size, std::size_t minBlockSize)
+{
+    assert(size && isPowerOfTwo(minBlockSize) && minBlockSize >= sizeof(FreeBlock));
+    m_minBlockShift = log2Ceil(minBlockSize);
+    m_size = std::max(std::size_t(1) << log2Ceil(size), std::max(minBlockSize, vmPageSize()));
+    m_maxOrder = log2Ceil(m_size) - m_minBlockShift;
+    assert(m_maxOrder < maxOrders);
+    
+    // aligning the region to its size aligns every block to its own size
+    m_base = static_cast<char*>(vmAllocateAligned(m_size, m_size));
+    // nodes are numbered from 1, so 2 << m_maxOrder bits cover the tree
+    auto bitmapWords = std::max<std::size_t>((std::size_t(2) << m_maxOrder) / 64, 1);
+    m_bitmapBytes = roundUpPowerOfTwo(2 * bitmapWords * sizeof(std::uint64_t), vmPageSize());
+    auto bitmaps = static_cast<std::uint64_t*>(m_base ? vmAllocate(m_bitmapBytes) : nullptr);
+    if (!bitmaps) {
+        if (m_base) {
+            vmDeallocate(m_base, m_size);
+            m_base = nullptr;
+        }
+        m_size = 0;
+        return;
+    }
+    // fresh pages are zero filled: nothing is split and nothing is free yet
+    m_splitBits = bitmaps;
+    m_freeBits = bitmaps + bitmapWords;
+    pushFree(1, m_maxOrder);
+}
+    
+BuddyAllocator::~BuddyAllocator()
+{
+    if (m_base) {
+        vmDeallocate(m_base, m_size);
+        vmDeallocate(m_splitBits, m_bitmapBytes);
+    }
+}
+    
+void* BuddyAllocator::malloc(std::size_t size, std::size_t alignment)
+{
+    assert(isValidAlignment(alignment));
+    auto order = orderFor(std::max(size, alignment));
+    if (order > m_maxOrder) {
+        return nullptr;
+    }
+    // the smallest free block large enough
+    auto candidates = m_nonEmptyLists >> order;
+    if (!candidates) {
+        return nullptr;
+    }
+    auto blockOrder = order + countTrailingZeros(candidates);
+    auto block = m_freeLists[blockOrder].first();
+    auto node = nodeOf(block, blockOrder);
+    removeFree(node, blockOrder);
+    
+    // split it down, keeping the left halves and freeing the right ones
+    for (; blockOrder > order; --blockOrder) {
+        MEMORY_TRACE_PATH(buddySplit);
+        setBit(m_splitBits, node, true);
+        node *= 2;
+        pushFree(node + 1, blockOrder - 1);
+    }
+    return block;
+}
+    
+void BuddyAllocator::free(void* p)
+{
+    if (!p) {
+        return;
+    }
+    assert(owns(p));
+    auto order = orderOf(p);
+    auto node = nodeOf(p, order);
+    assert(!testBit(m_freeBits, node));
+    
+    // merge with the buddy for as long as it is free too
+    for (; node > 1 && testBit(m_freeBits, node ^ 1); ++order) {
+        MEMORY_TRACE_PATH(buddyMerge);
+        removeFree(node ^ 1, order);
+        node /= 2;
+        setBit(m_splitBits, node, false);
+    }
+    pushFree(node, order);
+}
+    
+std::size_t BuddyAllocator::usableSize(const void* p) const
+{
+    assert(owns(p));
+    return std::size_t(1) << (orderOf(p) + m_minBlockShift);
+}
+    
+std::size_t BuddyAllocator::goodSize(std::size_t size, std::size_t alignment) const
+{
+    return std::size_t(1) << (orderFor(std::max(size, alignment)) + m_minBlockShift);
+}
+    
+bool BuddyAllocator::owns(const void* p) const
+{
+    return p >= m_base && p < m_base + m_size;
+}
+    
+std::size_t BuddyAllocator::orderFor(std::size_t size) const
+{
+    auto shift = log2Ceil(size);
+    return shift > m_minBlockShift ? shift - m_minBlockShift : 0;
+}
+    
+std::size_t BuddyAllocator::nodeOf(const void* p, std::size_t order) const
+{
+    auto offset = static_cast<std::size_t>(pointerDistanceTo(m_base, p));
+    return ((std::size_t(1) << (m_maxOrder - order)) + (offset >> (order + m_minBlockShift)));
+}
+    
+char* BuddyAllocator::blockOf(std::size_t node, std::size_t order) const
+{
+    auto first = std::size_t(1) << (m_maxOrder - order);
+    return m_base + ((node - first) << (order + m_minBlockShift));
+}
+    
+std::size_t BuddyAllocator::orderOf(const void* p) const
+{
+    auto order = m_maxOrder;
+    for (auto node = nodeOf(p, order); testBit(m_splitBits, node); node = nodeOf(p, order)) {
+        assert(order);
+        --order;
+    }
+    return order;
+}
+    
+bool BuddyAllocator::testBit(const std::uint64_t* bits, std::size_t node) const
+{
+    return bits[node / 64] >> (node % 64) & 1;
+}
+    
+void BuddyAllocator::setBit(std::uint64_t* bits, std::size_t node, bool value)
+{
+    auto mask = std::uint64_t(1) << (node % 64);
+    if (value) {
+        bits[node / 64] |= mask;
+    } else {
+        bits[node / 64] &= ~mask;
+    }
+}
+    
+void BuddyAllocator::pushFree(std::size_t node, std::size_t order)
+{
+    auto block = new (blockOf(node, order)) FreeBlock;
+    m_freeLists[order].addFirst(*block);
+    m_nonEmptyLists |= std::uint64_t(1) << order;
+    setBit(m_freeBits, node, true);
+}
+    
+void BuddyAllocator::removeFree(std::size_t node, std::size_t order)
+{
+    auto& list = m_freeLists[order];
+    list.remove(*reinterpret_cast<FreeBlock*>(blockOf(node, order)));
+    if (list.empty()) {
+        m_nonEmptyLists &= ~(std::uint64_t(1) << order);
+    }
+    setBit(m_freeBits, node, false);
+}
+
+} // namespace memory
@@ -0,0 +1,80 @@
+//
+//  buddy_allocator.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef BUDDY_ALLOCATOR_H
+#define BUDDY_ALLOCATOR_H
+
+#include "list.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace memory
+{
+    
+// Binary buddy allocator over a region mapped from the OS. Blocks are powers of
+// two between minBlockSize and the region size and are aligned to their size.
+// Which blocks are split and which are free is kept in bitmaps outside the
+// region, so a block in use carries no header; free blocks are linked into a
+// list per order through their first bytes.
+class BuddyAllocator
+{
+public:
+    // the region is `size' rounded up to a power of two and aligned to it
+    explicit BuddyAllocator(std::size_t size, std::size_t minBlockSize = 4096);
+    ~BuddyAllocator();
+    
+    BuddyAllocator(const BuddyAllocator&) = delete;
+    BuddyAllocator& operator =(const BuddyAllocator&) = delete;
+    
+    // the block is aligned to its size, an `alignment' up to the size is free
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void free(void* p);
+    
+    std::size_t usableSize(const void* p) const;
+    // the size of the block serving a request of `size' bytes
+    std::size_t goodSize(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) const;
+    bool owns(const void* p) const;
+private:
+    struct FreeBlock : ListNode<FreeBlock>
+    {
+    };
+    
+    // The blocks form a complete binary tree numbered from 1 at the root, the
+    // children of node i are 2i and 2i + 1. Order k blocks are minBlockSize << k
+    // bytes, the root has the highest order.
+    std::size_t orderFor(std::size_t size) const;
+    std::size_t nodeOf(const void* p, std::size_t order) const;
+    char* blockOf(std::size_t node, std::size_t order) const;
+    // the order of the allocated block at `p', found by descending the split nodes
+    std::size_t orderOf(const void* p) const;
+    
+    bool testBit(const std::uint64_t* bits, std::size_t node) const;
+    void setBit(std::uint64_t* bits, std::size_t node, bool value);
+    
+    void pushFree(std::size_t node, std::size_t order);
+    void removeFree(std::size_t node, std::size_t order);
+    
+    static constexpr std::size_t maxOrders = 64;
+    
+    char* m_base = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_minBlockShift = 0;
+    std::size_t m_maxOrder = 0;
+    // one bit per tree node each
+    std::uint64_t* m_splitBits = nullptr;
+    std::uint64_t* m_freeBits = nullptr;
+    std::size_t m_bitmapBytes = 0;
+    List<FreeBlock> m_freeLists[maxOrders];
+    // bit k is set if m_freeLists[k] has a block
+    std::uint64_t m_nonEmptyLists = 0;
+};
+
+} // namespace memory
+
+#endif /* BUDDY_ALLOCATOR_H */
@@ -0,0 +1,279 @@
+//
+//  epoch_reclaimer.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef EPOCH_RECLAIMER_H
+#define EPOCH_RECLAIMER_H
+
+#include "allocator_composition.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace memory
+{
+
+// Epoch based reclamation for lock-free data structures: a block unlinked
+// while other threads may still be reading it is retired instead of freed,
+// and freed once every thread that could have seen it has left its critical
+// section. Readers wrap their accesses in a Guard.
+//
+// Each thread buffers the blocks it retires, seals them into a batch once
+// there are `batchSize' of them, and frees whole batches two epochs later,
+// with freeBatch if the allocator has one. The epoch advances once all the
+// threads inside a critical section have entered in the current one. The
+// blocks are freed by the thread that retired them, so the allocator has to
+// take blocks of any thread, e.g. ThreadHeaps or StripedLargeAllocator. The
+// reclaimer must outlive the threads using it.
+//
+//     memory::EpochReclaimer<Heaps> epochs(heaps);
+//     {
+//         memory::EpochReclaimer<Heaps>::Guard guard(epochs);
+//         auto node = head.load();
+//         if (head.compare_exchange_strong(node, node->next)) {
+//             epochs.retire(node);
+//         }
+//     }
+template<typename Allocator>
+class EpochReclaimer
+{
+public:
+    class Guard
+    {
+    public:
+        explicit Guard(EpochReclaimer& reclaimer)
+            : m_reclaimer(reclaimer)
+        {
+            m_reclaimer.enter();
+        }
+
+        ~Guard()
+        {
+            m_reclaimer.leave();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator =(const Guard&) = delete;
+    private:
+        EpochReclaimer& m_reclaimer;
+    };
+
+    explicit EpochReclaimer(Allocator& allocator, std::size_t batchSize = 64)
+        : m_allocator(&allocator)
+        , m_batchSize(batchSize)
+    {
+        assert(batchSize);
+    }
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator =(const EpochReclaimer&) = delete;
+
+    // frees everything still retired, no thread may be inside a critical section
+    ~EpochReclaimer()
+    {
+        localRecords().remove(*this);
+        for (auto record = m_records.load(std::memory_order_acquire); record; ) {
+            assert(!record->depth);
+            auto next = record->next;
+            detail::deallocateBatch(*m_allocator, record->retired.data(), record->retired.size());
+            for (auto& batch : record->sealed) {
+                detail::deallocateBatch(*m_allocator, batch.blocks.data(), batch.blocks.size());
+            }
+            delete record;
+            record = next;
+        }
+    }
+
+    // critical sections may nest
+    void enter()
+    {
+        auto& record = localRecords().get(*this);
+        if (record.depth++ == 0) {
+            record.state.store(m_epoch.load(std::memory_order_relaxed) << 1 | 1, std::memory_order_relaxed);
+            // the announcement has to be visible before anything is read
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void leave()
+    {
+        auto& record = localRecords().get(*this);
+        assert(record.depth);
+        if (--record.depth == 0) {
+            record.state.store(0, std::memory_order_release);
+        }
+    }
+
+    // `p' is freed once no thread can be reading it any more, it has to be
+    // unlinked already
+    void retire(void* p)
+    {
+        if (!p) {
+            return;
+        }
+        auto& record = localRecords().get(*this);
+        record.retired.push_back(p);
+        if (record.retired.size() >= m_batchSize) {
+            collect(record);
+        }
+    }
+
+    // Seals the blocks the calling thread retired so far into a batch, and
+    // frees its batches which are safe. Returns the number of blocks freed.
+    std::size_t collect()
+    {
+        return collect(localRecords().get(*this));
+    }
+
+    std::uint64_t epoch() const { return m_epoch.load(std::memory_order_relaxed); }
+private:
+    struct Batch
+    {
+        std::uint64_t epoch;
+        std::vector<void*> blocks;
+    };
+
+    // a thread using the reclaimer, handed over to another one once it exits
+    struct Record
+    {
+        // the epoch the thread entered in shifted left by one, the lowest
+        // bit is set while it is inside a critical section
+        std::atomic<std::uint64_t> state{ 0 };
+        std::atomic<bool> taken{ true };
+        // records are only unlinked when the reclaimer is destroyed
+        Record* next = nullptr;
+        std::size_t depth = 0;
+        std::vector<void*> retired;
+        // oldest first
+        std::deque<Batch> sealed;
+    };
+
+    // the records of a thread, released when the thread exits
+    class LocalRecords
+    {
+    public:
+        ~LocalRecords()
+        {
+            for (auto& e : m_records) {
+                auto& record = *e.second;
+                e.first->seal(record);
+                record.taken.store(false, std::memory_order_release);
+            }
+        }
+
+        Record& get(EpochReclaimer& owner)
+        {
+            if (m_last && m_last->first == &owner) {
+                return *m_last->second;
+            }
+            for (auto& e : m_records) {
+                if (e.first == &owner) {
+                    m_last = &e;
+                    return *e.second;
+                }
+            }
+
+            m_records.emplace_back(&owner, &owner.acquireRecord());
+            m_last = &m_records.back();
+            return *m_last->second;
+        }
+
+        void remove(EpochReclaimer& owner)
+        {
+            m_last = nullptr;
+            m_records.erase(std::remove_if(m_records.begin(), m_records.end(), [&](auto& e) {
+                return e.first == &owner;
+            }), m_records.end());
+        }
+    private:
+        std::vector<std::pair<EpochReclaimer*, Record*>> m_records;
+        std::pair<EpochReclaimer*, Record*>* m_last = nullptr;
+    };
+
+    static LocalRecords& localRecords()
+    {
+        thread_local LocalRecords records;
+        return records;
+    }
+
+    // a record left by an exited thread, along with the batches it didn't
+    // get to free, or a new one
+    Record& acquireRecord()
+    {
+        for (auto record = m_records.load(std::memory_order_acquire); record; record = record->next) {
+            bool taken = false;
+            if (!record->taken.load(std::memory_order_relaxed) &&
+                record->taken.compare_exchange_strong(taken, true, std::memory_order_acquire)) {
+                return *record;
+            }
+        }
+        auto record = new Record;
+        record->next = m_records.load(std::memory_order_relaxed);
+        while (!m_records.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+        return *record;
+    }
+
+    void seal(Record& record)
+    {
+        if (record.retired.empty()) {
+            return;
+        }
+        // the blocks were unlinked before this, so no thread that entered
+        // after this epoch can reach them
+        record.sealed.push_back({ m_epoch.load(std::memory_order_seq_cst), std::move(record.retired) });
+        record.retired.clear();
+        record.retired.reserve(m_batchSize);
+    }
+
+    std::size_t collect(Record& record)
+    {
+        seal(record);
+        tryAdvance();
+        auto epoch = m_epoch.load(std::memory_order_acquire);
+        std::size_t freed = 0;
+        while (!record.sealed.empty() && record.sealed.front().epoch + 2 <= epoch) {
+            auto& blocks = record.sealed.front().blocks;
+            detail::deallocateBatch(*m_allocator, blocks.data(), blocks.size());
+            freed += blocks.size();
+            record.sealed.pop_front();
+        }
+        return freed;
+    }
+
+    // the epoch moves on once every thread inside a critical section is in it
+    void tryAdvance()
+    {
+        auto epoch = m_epoch.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto record = m_records.load(std::memory_order_acquire); record; record = record->next) {
+            // pairs with the release of leaving the critical section, what the
+            // thread read before happens before the blocks are freed
+            auto state = record->state.load(std::memory_order_acquire);
+            if ((state & 1) && state >> 1 != epoch) {
+                return;
+            }
+        }
+        m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    Allocator* m_allocator;
+    std::size_t m_batchSize;
+    std::atomic<std::uint64_t> m_epoch{ 0 };
+    std::atomic<Record*> m_records{ nullptr };
+};
+
+} // namespace memory
+
+#endif /* EPOCH_RECLAIMER_H */
@@ -12,6 +12,7 @@
 #include "memory_utils.h"
 
 #include <cstddef>
+#include <cstring>
 #include <algorithm>
 
 namespace memory
@@ -28,9 +29,11 @@ public:
 
     FreeList() = default;
     
-    FreeList(void* beg, void* end, std::size_t size)
+    // `zeroed' tells that the range is known to be filled with zeros, e.g. fresh
+    // pages from vmAllocate, so calloc doesn't have to clear untouched blocks
+    FreeList(void* beg, void* end, std::size_t size, bool zeroed = false)
     {
-        init(static_cast<char*>(beg), static_cast<char*>(end), size);
+        init(static_cast<char*>(beg), static_cast<char*>(end), size, zeroed);
     }
     
     FreeList(const FreeList&) = delete;
@@ -49,9 +52,21 @@ public:
     void swap(FreeList& rhs)
     {
         std::swap(m_head, rhs.m_head);
+        std::swap(m_untouched, rhs.m_untouched);
+        std::swap(m_end, rhs.m_end);
+        std::swap(m_blockSize, rhs.m_blockSize);
+        std::swap(m_capacity, rhs.m_capacity);
+        std::swap(m_zeroed, rhs.m_zeroed);
     }
     
-    bool empty() const { return !m_head; }
+    bool empty() const
+    {
+        return !m_head && !hasUntouched();
+    }
+    
+    std::size_t blockSize() const { return m_blockSize; }
+    // the number of blocks the range was split into
+    std::size_t capacity() const { return m_capacity; }
 
     void* malloc()
     {
@@ -60,7 +75,31 @@ public:
             m_head = m_head->next;
             return next;
         }
-        return nullptr;
+        return carve();
+    }
+    
+    void* calloc()
+    {
+        if (m_head) {
+            auto p = malloc();
+            std::memset(p, 0, m_blockSize);
+            return p;
+        }
+        auto p = carve();
+        if (p && !m_zeroed) {
+            std::memset(p, 0, m_blockSize);
+        }
+        return p;
+    }
+    
+    // allocate up to `count' blocks at once, returns the number of blocks allocated
+    std::size_t mallocBatch(void** out, std::size_t count)
+    {
+        std::size_t n = 0;
+        for (void* p; n < count && (p = malloc()); ) {
+            out[n++] = p;
+        }
+        return n;
     }
     
     void free(void* p)
@@ -72,12 +111,47 @@ public:
         }
     }
     
+    // every block handed out by this list has the same capacity
+    std::size_t usableSize(const void* p) const
+    {
+        assert(p);
+        return m_blockSize;
+    }
+    
+    static std::size_t goodSize(std::size_t n)
+    {
+        return adjustBlockSize(n);
+    }
+    
     static std::size_t adjustBlockSize(std::size_t n)
     {
         return roundUp(n, minBlockSize);
     }
+    
+    // the number of blocks of `size' a list over an aligned range of `bytes' holds
+    static std::size_t capacityFor(std::size_t bytes, std::size_t size)
+    {
+        return bytes / roundUpPowerOfTwo(size, sizeof(Block));
+    }
 private:
-    void init(char* beg, char* end, std::size_t size)
+    // blocks which have never been handed out are carved lazily, so they are
+    // neither touched by the construction nor dirtied by the links
+    bool hasUntouched() const
+    {
+        return m_untouched && static_cast<std::size_t>(m_end - m_untouched) >= m_blockSize;
+    }
+    
+    void* carve()
+    {
+        if (hasUntouched()) {
+            auto p = m_untouched;
+            m_untouched += m_blockSize;
+            return p;
+        }
+        return nullptr;
+    }
+    
+    void init(char* beg, char* end, std::size_t size, bool zeroed)
     {
         assert(beg && end && beg < end);
         
@@ -86,20 +160,22 @@ private:
         
         beg = align(beg, alignof(Block));
         assert(beg <= end);
+        m_capacity = capacityFor(end - beg, size);
         size = roundUpPowerOfTwo(size, sizeof(Block));
-        
-        auto cur = alignedCast<Block*>(beg);
-        auto numBlocks = (end - beg) / size;
-        if (numBlocks) {
-            m_head = cur;
-            for (std::size_t i = 0; i + 1 < numBlocks; ++i) {
-                cur = cur->next = alignedCast<Block*>(pointerAdd(cur, size));
-            }
-            cur->next = nullptr;
-        }
+        m_blockSize = size;
+        m_untouched = beg;
+        m_end = end;
+        m_zeroed = zeroed;
     }
     
+    // blocks which were freed
     Block* m_head = nullptr;
+    // [m_untouched, m_end) has never been handed out
+    char* m_untouched = nullptr;
+    char* m_end = nullptr;
+    std::size_t m_blockSize = 0;
+    std::size_t m_capacity = 0;
+    bool m_zeroed = false;
 };
 
 } // namespace memory
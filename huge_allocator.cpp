@@ -0,0 +1,92 @@
+//
+//  huge_allocator.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "huge_allocator.h"
+#include "memory_utils.h"
+#include "os_memory.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace memory
+{
+    
+void* HugeAllocator::malloc(std::size_t size, std::size_t alignment)
+{
+    assert(size);
+    assert(isValidAlignment(alignment));
+    // the mapping is page aligned, so is anything inside the first page
+    assert(alignment <= vmPageSize());
+    
+    auto offset = headerSize(alignment);
+    auto mappedSize = roundUpPowerOfTwo(offset + size, vmPageSize());
+    auto base = static_cast<char*>(vmAllocate(mappedSize));
+    if (!base) {
+        return nullptr;
+    }
+    
+    auto user = base + offset;
+    header(user) = { mappedSize, offset };
+    return user;
+}
+    
+void* HugeAllocator::realloc(void* p, std::size_t size)
+{
+    if (!p) {
+        return malloc(size);
+    }
+    assert(size);
+    
+    auto h = header(p);
+    auto mappedSize = roundUpPowerOfTwo(h.offset + size, vmPageSize());
+    if (mappedSize == h.mappedSize) {
+        return p;
+    }
+    
+    auto base = static_cast<char*>(vmReallocate(static_cast<char*>(p) - h.offset, h.mappedSize, mappedSize));
+    if (!base) {
+        return nullptr;
+    }
+    
+    auto user = base + h.offset;
+    header(user).mappedSize = mappedSize;
+    return user;
+}
+    
+void HugeAllocator::free(void* p)
+{
+    if (p) {
+        auto h = header(p);
+        vmDeallocate(static_cast<char*>(p) - h.offset, h.mappedSize);
+    }
+}
+    
+std::size_t HugeAllocator::usableSize(const void* p) const
+{
+    assert(p);
+    const auto& h = header(const_cast<void*>(p));
+    return h.mappedSize - h.offset;
+}
+    
+std::size_t HugeAllocator::goodSize(std::size_t size, std::size_t alignment)
+{
+    auto offset = headerSize(alignment);
+    return roundUpPowerOfTwo(offset + size, vmPageSize()) - offset;
+}
+    
+std::size_t HugeAllocator::headerSize(std::size_t alignment)
+{
+    return roundUpPowerOfTwo(sizeof(Header), std::max(alignment, alignof(Header)));
+}
+    
+HugeAllocator::Header& HugeAllocator::header(void* p)
+{
+    return alignedCast<Header*>(p)[-1];
+}
+    
+} // namespace memory
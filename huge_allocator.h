@@ -0,0 +1,45 @@
+//
+//  huge_allocator.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef HUGE_ALLOCATOR_H
+#define HUGE_ALLOCATOR_H
+
+#include <cstddef>
+
+namespace memory
+{
+    
+// Maps every allocation directly from the OS. Meant for multi-megabyte buffers
+// which would otherwise fragment a LargeAllocator arena; growing such a buffer
+// remaps its pages instead of copying them.
+class HugeAllocator
+{
+public:
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void* realloc(void* p, std::size_t size);
+    void free(void* p);
+    
+    std::size_t usableSize(const void* p) const;
+    static std::size_t goodSize(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+private:
+    // stored right before the user memory
+    struct Header
+    {
+        // length of the whole mapping
+        std::size_t mappedSize;
+        // distance from the start of the mapping to the user memory
+        std::size_t offset;
+    };
+    
+    static std::size_t headerSize(std::size_t alignment);
+    static Header& header(void* p);
+};
+
+} // namespace memory
+
+#endif /* HUGE_ALLOCATOR_H */
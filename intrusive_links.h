@@ -0,0 +1,120 @@
+//
+//  intrusive_links.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef INTRUSIVE_LINKS_H
+#define INTRUSIVE_LINKS_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+// How the nodes of an RbTree or a List refer to each other. A Link holds a
+// pointer to a node, a TaggedLink a pointer and a flag, e.g. the color of a
+// tree node.
+
+// plain pointers, the flag is kept in the lowest bit
+struct PointerLinks
+{
+    // the farthest apart two linked nodes may lie
+    static constexpr std::size_t maxDistance = SIZE_MAX;
+    
+    template<typename T>
+    class Link
+    {
+    public:
+        T* get() const { return m_p; }
+        void set(T* p) { m_p = p; }
+    private:
+        T* m_p = nullptr;
+    };
+
+    template<typename T>
+    class TaggedLink
+    {
+    public:
+        T* get() const
+        {
+            return reinterpret_cast<T*>(m_bits & ~std::uintptr_t(1));
+        }
+
+        void set(T* p)
+        {
+            assert(!(reinterpret_cast<std::uintptr_t>(p) & 1));
+            m_bits = reinterpret_cast<std::uintptr_t>(p) | tag();
+        }
+
+        bool tag() const { return m_bits & 1; }
+        void setTag(bool tag) { m_bits = (m_bits & ~std::uintptr_t(1)) | tag; }
+    private:
+        std::uintptr_t m_bits = 0;
+    };
+};
+
+// Distances from the link itself in units of 4 bytes, stored in 32 bits. They
+// take half the space of pointers but only reach nodes within 8 GiB, or 4 GiB
+// for a TaggedLink, e.g. nodes of the same arena. Linked nodes can't be moved
+// or copied, the links would point elsewhere.
+struct CompressedLinks
+{
+    static constexpr std::ptrdiff_t unit = 4;
+    static constexpr std::size_t maxDistance = std::size_t(INT32_MAX / 2) * unit;
+
+    template<typename T>
+    class Link
+    {
+    public:
+        T* get() const { return decode<T>(this, m_offset); }
+        void set(T* p) { m_offset = encode(this, p, INT32_MIN, INT32_MAX); }
+    private:
+        std::int32_t m_offset = 0;
+    };
+
+    // the flag is kept in the lowest bit, the distance in the others
+    template<typename T>
+    class TaggedLink
+    {
+    public:
+        T* get() const { return decode<T>(this, m_bits >> 1); }
+
+        void set(T* p)
+        {
+            m_bits = encode(this, p, INT32_MIN / 2, INT32_MAX / 2) * 2 + tag();
+        }
+
+        bool tag() const { return m_bits & 1; }
+        void setTag(bool tag) { m_bits = (m_bits & ~std::int32_t(1)) | tag; }
+    private:
+        std::int32_t m_bits = 0;
+    };
+private:
+    // a node never links to the link itself, 0 stands for null
+    static std::int32_t encode(const void* link, const void* p, std::int32_t min, std::int32_t max)
+    {
+        if (!p) {
+            return 0;
+        }
+        auto distance = static_cast<const char*>(p) - static_cast<const char*>(link);
+        assert(distance && distance % unit == 0);
+        assert(distance / unit >= min && distance / unit <= max);
+        (void)min;
+        (void)max;
+        return static_cast<std::int32_t>(distance / unit);
+    }
+
+    template<typename T>
+    static T* decode(const void* link, std::int32_t offset)
+    {
+        if (!offset) {
+            return nullptr;
+        }
+        auto p = const_cast<char*>(static_cast<const char*>(link)) + offset * unit;
+        return reinterpret_cast<T*>(p);
+    }
+};
+
+#endif /* INTRUSIVE_LINKS_H */
@@ -9,74 +9,140 @@
 #include "large_allocator.h"
 #include "aligned_alloc.h"
 #include "memory_utils.h"
+#include "os_memory.h"
+#include "trace_path.h"
 
 #include <new>
+#include <limits>
+#include <cstring>
 #include <cassert>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 namespace memory
 {
     
-LargeAllocator::LargeAllocator(void* beg, void* end, std::size_t minBlockSize)
-    : m_minBlockSize(roundUpPowerOfTwo(minBlockSize, alignof(Block)))
+template<typename Links>
+BasicLargeAllocator<Links>::BasicLargeAllocator(void* beg, void* end, std::size_t minBlockSize, bool zeroed, FitPolicy policy)
+    : BasicLargeAllocator(minBlockSize, policy)
 {
-    init((char*)beg, (char*)end);
+    init((char*)beg, (char*)end, zeroed);
 }
 
-LargeAllocator::LargeAllocator(LargeAllocator&& rhs)
+template<typename Links>
+BasicLargeAllocator<Links>::BasicLargeAllocator(std::size_t minBlockSize, FitPolicy policy)
+    : m_policy(policy)
+    , m_minBlockSize(roundUpPowerOfTwo(minBlockSize, alignof(Block)))
+{
+}
+
+template<typename Links>
+BasicLargeAllocator<Links>::BasicLargeAllocator(BasicLargeAllocator&& rhs)
 {
     swap(rhs);
 }
 
-LargeAllocator& LargeAllocator::operator =(LargeAllocator&& rhs)
+template<typename Links>
+BasicLargeAllocator<Links>& BasicLargeAllocator<Links>::operator =(BasicLargeAllocator&& rhs)
 {
     swap(rhs);
     return *this;
 }
 
-void LargeAllocator::swap(LargeAllocator& rhs)
+template<typename Links>
+void BasicLargeAllocator<Links>::swap(BasicLargeAllocator& rhs)
 {
     std::swap(m_minBlockSize, rhs.m_minBlockSize);
-    m_blocks.swap(rhs.m_blocks);
-    m_freeList.swap(rhs.m_freeList);
+    std::swap(m_beg, rhs.m_beg);
+    std::swap(m_end, rhs.m_end);
+    std::swap(m_index, rhs.m_index);
+    std::swap(m_policy, rhs.m_policy);
+}
+
+template<typename Links>
+BasicLargeAllocator<Links> BasicLargeAllocator<Links>::attach(void* beg, void* end, std::size_t minBlockSize,
+                                                              FitPolicy policy)
+{
+    assert(beg && end && beg <= end);
+    BasicLargeAllocator allocator(minBlockSize, policy);
+    allocator.m_beg = static_cast<char*>(beg);
+    allocator.m_end = static_cast<char*>(end);
+    allocator.m_index = reinterpret_cast<Index*>(indexIn(allocator.m_beg, allocator.m_end));
+    return allocator;
+}
+
+template<typename Links>
+void* BasicLargeAllocator<Links>::malloc(std::size_t size, std::size_t alignment)
+{
+    std::size_t dirtySize;
+    return allocate(size, alignment, dirtySize);
 }
 
-void* LargeAllocator::malloc(std::size_t size, std::size_t alignment)
+template<typename Links>
+void* BasicLargeAllocator<Links>::calloc(std::size_t count, std::size_t size, std::size_t alignment)
+{
+    if (size && count > std::numeric_limits<std::size_t>::max() / size) {
+        return nullptr;
+    }
+    
+    std::size_t dirtySize;
+    auto p = allocate(count * size, alignment, dirtySize);
+    if (p) {
+        zeroMemory(p, std::min(dirtySize, count * size));
+    }
+    return p;
+}
+
+template<typename Links>
+void* BasicLargeAllocator<Links>::allocate(std::size_t size, std::size_t alignment, std::size_t& dirtySize)
 {
     assert(size);
     assert(isValidAlignment(alignment));
     
     alignment = std::max(alignment, alignof(Block));
     
-    Block targetBlock;
     // need to take into account Block alignment
     auto payloadSize = roundUpPowerOfTwo(size, alignof(Block));
-    targetBlock.size = calcAlignedAllocSize(payloadSize, alignment);
-    if (auto it = m_freeList.lowerBound(targetBlock); it != m_freeList.end()) {
-        m_freeList.remove(*it);
+    auto targetSize = calcAlignedAllocSize(payloadSize, alignment);
+    if (auto found = findFree(targetSize)) {
+        removeFree(*found);
         
-        auto& block = const_cast<Block&>(*it);
-        block.free = false;
+        auto& block = *found;
+        auto dirty = block.dirtySize();
         
-        auto minSizeForSplit = targetBlock.size + sizeof(Block) + m_minBlockSize;
+        auto minSizeForSplit = targetSize + sizeof(Block) + m_minBlockSize;
         // can split
         if (block.size >= minSizeForSplit) {
+            MEMORY_TRACE_PATH(largeSplit);
             auto oldSize = block.size;
-            block.size = targetBlock.size;
+            block.size = targetSize;
             
             auto next = new (pointerAdd(&block, block.totalSize())) Block;
-            next->size = oldSize - targetBlock.size - sizeof(Block);
+            next->size = oldSize - targetSize - sizeof(Block);
             next->free = true;
+            // the header is carved from the payload, the rest of the payload stays intact
+            auto nextOffset = targetSize + sizeof(Block);
+            next->setDirtySize(dirty > nextOffset ? dirty - nextOffset : 0);
 
-            m_blocks.insertAfter(*next, block);
-            m_freeList.insert(*next);
+            m_index->blocks.insertAfter(*next, block);
+            insertFree(*next);
         }
+        // only now, a heap recovered after a crash in between finds the block free
+        block.free = false;
+        block.zeroed = false;
 
-        return adjustForAlignedAlloc(pointerAdd(&block, sizeof(Block)), alignment);
+        auto p = adjustForAlignedAlloc(pointerAdd(&block, sizeof(Block)), alignment);
+        auto offset = pointerDistanceTo(&block + 1, p);
+        dirtySize = dirty > static_cast<std::size_t>(offset) ? dirty - offset : 0;
+        return p;
     }
+    MEMORY_TRACE_PATH(largeNoFit);
     return nullptr;
 }
 
-void LargeAllocator::free(void* p)
+template<typename Links>
+void BasicLargeAllocator<Links>::free(void* p)
 {
     if (p) {
         auto block = alignedCast<Block*>(getUnalignedAlloc(p)) - 1;
@@ -84,51 +150,295 @@ void LargeAllocator::free(void* p)
         
         // coalesce with the previous or the next block if possible
         if (auto prev = block->prev(); prev && prev->free) {
-            m_freeList.remove(*prev);
-            m_blocks.remove(*block);
+            MEMORY_TRACE_PATH(largeCoalesce);
+            removeFree(*prev);
+            m_index->blocks.remove(*block);
             prev->size += block->totalSize();
             block = prev;
         }
         
+        // The freed payload is dirty, and so is anything merged before it. A
+        // zeroed block merged after it only lengthens the dirty prefix, which
+        // is the common case as blocks are carved from the front of free ones.
+        auto dirty = block->size;
         if (auto next = block->next(); next && next->free) {
-            m_freeList.remove(*next);
-            m_blocks.remove(*next);
+            MEMORY_TRACE_PATH(largeCoalesce);
+            removeFree(*next);
+            m_index->blocks.remove(*next);
+            dirty = block->size + sizeof(Block) + next->dirtySize();
             block->size += next->totalSize();
         }
         
-        m_freeList.insert(*block);
+        block->setDirtySize(dirty);
+        insertFree(*block);
     }
 }
 
-void LargeAllocator::init(char* beg, char* end)
+template<typename Links>
+std::size_t BasicLargeAllocator<Links>::usableSize(const void* p) const
+{
+    assert(p);
+    auto user = const_cast<void*>(p);
+    auto block = alignedCast<const Block*>(getUnalignedAlloc(user)) - 1;
+    // the payload starts right after the header, the user pointer is offset for alignment
+    return block->size - pointerDistanceTo(block + 1, user);
+}
+
+template<typename Links>
+std::size_t BasicLargeAllocator<Links>::goodSize(std::size_t size)
+{
+    // the alignment padding is reserved on top of the payload, so at least the
+    // rounded payload is always usable
+    return roundUpPowerOfTwo(size, alignof(Block));
+}
+
+template<typename Links>
+std::size_t BasicLargeAllocator<Links>::purge()
+{
+    std::size_t purged = 0;
+    if (!m_index) {
+        return purged;
+    }
+    auto purgeBlocks = [&](auto& freeBlocks) {
+        for (auto& b : freeBlocks) {
+            auto& block = const_cast<Block&>(b);
+            auto dirty = block.dirtySize();
+            if (!dirty) {
+                continue;
+            }
+            
+            // past the dirty prefix the pages hold zeros already
+            auto payload = reinterpret_cast<char*>(&block + 1);
+            auto dirtyEnd = payload + dirty;
+            auto pagesBeg = roundUpPowerOfTwo(payload, vmPageSize());
+            auto pagesEnd = roundDownPowerOfTwo(dirtyEnd, vmPageSize());
+            if (pagesBeg < pagesEnd) {
+                vmPurge(pagesBeg, pagesEnd - pagesBeg);
+                // the partial pages at both ends are too small to give back
+                std::memset(payload, 0, pagesBeg - payload);
+                std::memset(pagesEnd, 0, dirtyEnd - pagesEnd);
+                block.setDirtySize(0);
+                purged += pagesEnd - pagesBeg;
+            }
+        }
+    };
+    if (m_policy == FitPolicy::bestFit) {
+        purgeBlocks(m_index->bySize);
+    } else {
+        purgeBlocks(m_index->byAddress);
+    }
+    return purged;
+}
+
+template<typename Links>
+bool BasicLargeAllocator<Links>::recover()
+{
+    if (!m_index) {
+        return false;
+    }
+    
+    // A call stopped half way leaves a block being split off or merged either
+    // linked in by the next link before it or not at all, while the sizes and
+    // the prev links may lag behind. So the blocks are walked by their next
+    // links, and the rest is derived from where they lie. Each block has to
+    // lie past the header of the previous one, which also keeps the walk from
+    // running in circles over garbage links.
+    auto beg = align(reinterpret_cast<char*>(m_index) + sizeof(Index), alignof(Block));
+    std::vector<Block*> blocks;
+    for (auto block = m_index->blocks.first(); block; block = block->next()) {
+        auto p = reinterpret_cast<char*>(block);
+        auto min = blocks.empty() ? beg : reinterpret_cast<char*>(blocks.back()) + sizeof(Block);
+        if ((blocks.empty() && p != beg) || p < min || p + sizeof(Block) > m_end ||
+            reinterpret_cast<std::uintptr_t>(p) % alignof(Block)) {
+            return false;
+        }
+        blocks.push_back(block);
+    }
+    if (blocks.empty()) {
+        return false;
+    }
+    new (&m_index->blocks) List<Block, Links>;
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+        auto end = i + 1 < blocks.size() ? reinterpret_cast<char*>(blocks[i + 1]) : m_end;
+        blocks[i]->setTotalSize(end - reinterpret_cast<char*>(blocks[i]));
+        m_index->blocks.addLast(*blocks[i]);
+    }
+    
+    std::vector<Block*> freeBlocks;
+    for (auto block = m_index->blocks.first(); block; ) {
+        auto next = block->next();
+        // the payload may have been written since the flag was set
+        block->zeroed = false;
+        // a free interrupted before coalescing leaves free neighbours
+        if (block->free && !freeBlocks.empty() && block->prev() == freeBlocks.back()) {
+            m_index->blocks.remove(*block);
+            freeBlocks.back()->size += block->totalSize();
+        } else if (block->free) {
+            freeBlocks.push_back(block);
+        }
+        block = next;
+    }
+    
+    if (m_policy == FitPolicy::bestFit) {
+        std::stable_sort(freeBlocks.begin(), freeBlocks.end(), [](const Block* a, const Block* b) {
+            return a->size < b->size;
+        });
+        m_index->bySize.clear();
+        m_index->bySize.buildFromSorted(freeBlocks.begin(), freeBlocks.end());
+    } else {
+        m_index->byAddress.clear();
+        m_index->byAddress.buildFromSorted(freeBlocks.begin(), freeBlocks.end());
+    }
+    return true;
+}
+
+template<typename Links>
+void BasicLargeAllocator<Links>::init(char* beg, char* end, bool zeroed)
 {
     assert(beg && end && beg <= end);
+    m_beg = beg;
+    m_end = end;
     
-    beg = align(beg, alignof(Block));
-    if (beg + sizeof(Block) <= end) {
-        auto block = new (beg) Block;
+    if (auto index = indexIn(beg, end)) {
+        m_index = new (index) Index;
+        auto blocks = align(index + sizeof(Index), alignof(Block));
+        auto block = new (blocks) Block;
         block->free = true;
-        block->setTotalSize(end - beg);
+        block->zeroed = zeroed;
+        block->setTotalSize(end - blocks);
 
-        m_freeList.insert(*block);
-        m_blocks.addFirst(*block);
+        insertFree(*block);
+        m_index->blocks.addFirst(*block);
     }
 }
 
-void LargeAllocator::Block::setTotalSize(std::size_t total)
+template<typename Links>
+void BasicLargeAllocator<Links>::Block::setTotalSize(std::size_t total)
 {
     assert(total >= sizeof(Block));
     size = total - sizeof(Block);
 }
     
-std::size_t LargeAllocator::Block::totalSize() const
+template<typename Links>
+std::size_t BasicLargeAllocator<Links>::Block::totalSize() const
 {
     return sizeof(Block) + size;
 }
+
+template<typename Links>
+std::size_t BasicLargeAllocator<Links>::Block::dirtySize() const
+{
+    if (!zeroed) {
+        return size;
+    }
+    return size >= sizeof(std::size_t) ? *reinterpret_cast<const std::size_t*>(this + 1) : 0;
+}
+
+template<typename Links>
+void BasicLargeAllocator<Links>::Block::setDirtySize(std::size_t dirty)
+{
+    zeroed = !dirty || dirty < size;
+    // the word lies in the prefix, or is zero already with the rest of the
+    // payload, writing it would fault in a page that may be untouched
+    if (zeroed && dirty) {
+        *reinterpret_cast<std::size_t*>(this + 1) = dirty;
+    }
+}
+    
+template<typename Links>
+bool BasicLargeAllocator<Links>::SizeLess::operator()(const Block& a, const Block& b) const
+{
+    return a.size < b.size;
+}
+    
+template<typename Links>
+bool BasicLargeAllocator<Links>::SizeLess::operator()(const Block& a, std::size_t size) const
+{
+    return a.size < size;
+}
+    
+template<typename Links>
+bool BasicLargeAllocator<Links>::SizeLess::operator()(std::size_t size, const Block& b) const
+{
+    return size < b.size;
+}
+    
+template<typename Links>
+bool BasicLargeAllocator<Links>::AddressLess::operator()(const Block& a, const Block& b) const
+{
+    return std::less<const Block*>()(&a, &b);
+}
+    
+template<typename Links>
+void BasicLargeAllocator<Links>::MaxFreeSize::operator()(Block& block, const Block* left, const Block* right) const
+{
+    std::size_t maxSize = block.size;
+    if (left) {
+        maxSize = std::max(maxSize, left->maxFreeSize);
+    }
+    if (right) {
+        maxSize = std::max(maxSize, right->maxFreeSize);
+    }
+    block.maxFreeSize = maxSize;
+}
+    
+template<typename Links>
+char* BasicLargeAllocator<Links>::indexIn(char* beg, char* end)
+{
+    auto index = align(beg, alignof(Index));
+    auto blocks = align(index + sizeof(Index), alignof(Block));
+    return blocks + sizeof(Block) <= end && static_cast<std::size_t>(end - beg) <= Links::maxDistance ? index
+                                                                                                     : nullptr;
+}
+    
+template<typename Links>
+typename BasicLargeAllocator<Links>::Block* BasicLargeAllocator<Links>::findFree(std::size_t size)
+{
+    if (!m_index) {
+        return nullptr;
+    }
+    if (m_policy == FitPolicy::bestFit) {
+        auto it = m_index->bySize.lowerBound(size);
+        return it != m_index->bySize.end() ? const_cast<Block*>(&*it) : nullptr;
+    }
+    
+    // the leftmost block large enough, following the subtrees which have one
+    auto it = m_index->byAddress.descend([size](const Block& block, const Block* left, const Block* right) {
+        if (left && left->maxFreeSize >= size) {
+            return RbTreeDirection::left;
+        }
+        if (block.size >= size) {
+            return RbTreeDirection::here;
+        }
+        if (right && right->maxFreeSize >= size) {
+            return RbTreeDirection::right;
+        }
+        return RbTreeDirection::none;
+    });
+    return it != m_index->byAddress.end() ? const_cast<Block*>(&*it) : nullptr;
+}
     
-bool LargeAllocator::Block::operator <(const Block& rhs) const
+template<typename Links>
+void BasicLargeAllocator<Links>::insertFree(Block& block)
 {
-    return size < rhs.size;
+    if (m_policy == FitPolicy::bestFit) {
+        m_index->bySize.insert(block);
+    } else {
+        m_index->byAddress.insert(block);
+    }
 }
     
+template<typename Links>
+void BasicLargeAllocator<Links>::removeFree(Block& block)
+{
+    if (m_policy == FitPolicy::bestFit) {
+        m_index->bySize.remove(block);
+    } else {
+        m_index->byAddress.remove(block);
+    }
+}
+    
+template class BasicLargeAllocator<PointerLinks>;
+template class BasicLargeAllocator<CompressedLinks>;
+    
 } // namespace memory
@@ -18,41 +18,140 @@
 namespace memory
 {
     
-class LargeAllocator
+// Links selects the links of the block headers, see intrusive_links.h. The
+// block list and the free block index lie at the start of the arena, within
+// reach of the blocks, so with CompressedLinks the whole heap is position
+// independent: it can be mapped elsewhere, or by another process, and attached.
+template<typename Links>
+class BasicLargeAllocator
 {
 public:
-    LargeAllocator(void* beg, void* end, std::size_t minBlockSize = 0);
+    // how the free block serving a request is picked
+    enum class FitPolicy {
+        // the smallest one large enough
+        bestFit,
+        // the one large enough with the lowest address, which keeps the blocks
+        // packed towards the start of the arena
+        addressFirstFit
+    };
+    
+    // `zeroed' tells that [beg, end) is known to be filled with zeros, e.g. fresh pages from vmAllocate.
+    // An arena larger than Links::maxDistance is out of reach of the links and fails every request.
+    BasicLargeAllocator(void* beg, void* end, std::size_t minBlockSize = 0, bool zeroed = false,
+                        FitPolicy policy = FitPolicy::bestFit);
+
+    // an allocator without an arena, which fails every request until another one is moved in
+    BasicLargeAllocator() : BasicLargeAllocator(0, FitPolicy::bestFit) {}
 
-    LargeAllocator(const LargeAllocator&) = delete;
-    LargeAllocator& operator =(const LargeAllocator&) = delete;
+    BasicLargeAllocator(const BasicLargeAllocator&) = delete;
+    BasicLargeAllocator& operator =(const BasicLargeAllocator&) = delete;
     
-    LargeAllocator(LargeAllocator&& rhs);
-    LargeAllocator& operator =(LargeAllocator&& rhs);
+    BasicLargeAllocator(BasicLargeAllocator&& rhs);
+    BasicLargeAllocator& operator =(BasicLargeAllocator&& rhs);
 
-    void swap(LargeAllocator& rhs);
+    void swap(BasicLargeAllocator& rhs);
+    
+    // Takes over the heap an allocator laid out over the same memory, mapped
+    // at [beg, end) now. It takes the same minBlockSize and policy. Only a heap
+    // with CompressedLinks may have moved since.
+    static BasicLargeAllocator attach(void* beg, void* end, std::size_t minBlockSize = 0,
+                                      FitPolicy policy = FitPolicy::bestFit);
     
     void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void* calloc(std::size_t count, std::size_t size, std::size_t alignment = alignof(std::max_align_t));
     void free(void* p);
+    
+    // return the pages of free blocks to the OS, the arena must be private anonymous memory
+    std::size_t purge();
+    
+    // Repairs the block list of a heap attached after its owner stopped in the
+    // middle of a call, a split or a merge half done included, and rebuilds the
+    // free block index from it. Returns false if the list is damaged, the heap
+    // can't be used then.
+    bool recover();
+    
+    // the number of bytes that can actually be used behind `p'
+    std::size_t usableSize(const void* p) const;
+    // the capacity guaranteed for a request of `size' bytes
+    static std::size_t goodSize(std::size_t size);
+    // whether `p' lies in the arena
+    bool owns(const void* p) const { return p >= m_beg && p < m_end; }
 private:
-    void init(char* beg, char* end);
+    BasicLargeAllocator(std::size_t minBlockSize, FitPolicy policy);
+    
+    void init(char* beg, char* end, bool zeroed);
+    // `dirtySize' receives how many bytes from the block returned may not be zero
+    void* allocate(std::size_t size, std::size_t alignment, std::size_t& dirtySize);
     
-    struct Block : RbTreeNode, ListNode<Block>
+    struct Block : BasicRbTreeChainNode<Links>, ListNode<Block, Links>
     {
-        std::size_t size : sizeof(std::size_t) * 8 - 1;
+        std::size_t size : sizeof(std::size_t) * 8 - 2;
         std::size_t free : 1;
+        // the payload past its dirty prefix is known to be filled with zeros
+        std::size_t zeroed : 1;
+        // the largest size of the subtree in the address ordered index
+        std::size_t maxFreeSize;
 
         std::size_t totalSize() const;
         void setTotalSize(std::size_t total);
+        // The bytes at the start of the payload of a free block which may not
+        // be zero, all of them unless it is zeroed. The length is kept in the
+        // first word of the payload, which is zero for no prefix.
+        std::size_t dirtySize() const;
+        void setDirtySize(std::size_t dirty);
+    };
+    
+    // orders blocks by size, and compares them with plain sizes to look one up
+    struct SizeLess
+    {
+        using is_transparent = void;
         
-        bool operator <(const Block& rhs) const;
+        bool operator()(const Block& a, const Block& b) const;
+        bool operator()(const Block& a, std::size_t size) const;
+        bool operator()(std::size_t size, const Block& b) const;
     };
     
-    // all the blocks, allocated or free, ordered by address
-    List<Block> m_blocks;
-    RbTree<Block> m_freeList;
+    struct AddressLess
+    {
+        bool operator()(const Block& a, const Block& b) const;
+    };
+    
+    struct MaxFreeSize
+    {
+        void operator()(Block& block, const Block* left, const Block* right) const;
+    };
+    
+    struct Index
+    {
+        // all the blocks, allocated or free, ordered by address
+        List<Block, Links> blocks;
+        // the free blocks by size for best fit, or by address for first fit
+        RbTree<Block, SizeLess> bySize;
+        RbTree<Block, AddressLess, MaxFreeSize> byAddress;
+    };
+    
+    // where the index of a heap over [beg, end) lies, null if there is no room for a block or
+    // the links can't span it
+    static char* indexIn(char* beg, char* end);
+    Block* findFree(std::size_t size);
+    void insertFree(Block& block);
+    void removeFree(Block& block);
+    
+    // null if the arena is too small for a block
+    Index* m_index = nullptr;
+    FitPolicy m_policy = FitPolicy::bestFit;
     std::size_t m_minBlockSize;
+    char* m_beg = nullptr;
+    char* m_end = nullptr;
 };
 
+extern template class BasicLargeAllocator<PointerLinks>;
+extern template class BasicLargeAllocator<CompressedLinks>;
+
+using LargeAllocator = BasicLargeAllocator<PointerLinks>;
+// block headers of 48 bytes instead of 72, for arenas of up to 4 GiB
+using CompressedLargeAllocator = BasicLargeAllocator<CompressedLinks>;
+
 } // namespace memory
 
 #endif /* MEMORY_H */
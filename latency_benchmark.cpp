@@ -0,0 +1,628 @@
+//
+//  latency_benchmark.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+// Times every single malloc and free of each allocator instead of whole
+// loops, to show the tail the averages of benchmark.cpp hide. Each phase of a
+// workload prints the percentiles of its calls, the hardware counters read
+// around it, and for each slow path traced with MEMORY_TRACE_PATH how often the
+// calls taking it were slow, so a spike can be put down to e.g. a page refill.
+
+#include "segregated_allocator.h"
+#include "thread_heap.h"
+#include "large_allocator.h"
+#include "lifetime_allocator.h"
+#include "striped_large_allocator.h"
+#include "shared_large_allocator.h"
+#include "persistent_heap.h"
+#include "buddy_allocator.h"
+#include "huge_allocator.h"
+#include "monotonic_arena.h"
+#include "object_pool.h"
+#include "os_memory.h"
+#include "trace_path.h"
+
+#ifndef MEMORY_TRACE_PATHS
+#  error "the allocators have to be built with MEMORY_TRACE_PATHS defined"
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#endif
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+
+#if defined(__x86_64__) || defined(__i386__)
+const char* const timeUnit = "cycles";
+
+// the fences keep the timed call from leaking out of the measurement
+inline uint64_t startTimer()
+{
+    _mm_lfence();
+    auto t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+inline uint64_t stopTimer()
+{
+    unsigned aux;
+    auto t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+#else
+const char* const timeUnit = "ns";
+
+inline uint64_t startTimer()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t stopTimer()
+{
+    return startTimer();
+}
+#endif
+
+// Counts values in log-linear buckets like HdrHistogram: values below
+// 2 * subBuckets are exact, each power of two above is split into subBuckets
+// buckets, so a value is off by less than 1 / subBuckets.
+class Histogram
+{
+public:
+    void record(uint64_t value)
+    {
+        ++m_counts[bucketOf(value)];
+        ++m_count;
+        m_max = std::max(m_max, value);
+    }
+
+    uint64_t count() const { return m_count; }
+    uint64_t max() const { return m_max; }
+
+    // the highest value of the bucket holding the `p' percentile
+    uint64_t percentile(double p) const
+    {
+        if (!m_count) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(p / 100 * (m_count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < numBuckets; ++b) {
+            seen += m_counts[b];
+            if (seen >= rank) {
+                return std::min(highestOf(b), m_max);
+            }
+        }
+        return m_max;
+    }
+private:
+    static constexpr unsigned subBucketBits = 5;
+    static constexpr uint64_t subBuckets = uint64_t(1) << subBucketBits;
+    static constexpr size_t numBuckets = (64 - subBucketBits) * subBuckets + subBuckets;
+
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < 2 * subBuckets) {
+            return value;
+        }
+        unsigned shift = 63 - memory::countLeadingZeros(value) - subBucketBits;
+        return shift * subBuckets + (value >> shift);
+    }
+
+    static uint64_t lowestOf(size_t bucket)
+    {
+        if (bucket < 2 * subBuckets) {
+            return bucket;
+        }
+        auto shift = bucket / subBuckets - 1;
+        return (bucket - shift * subBuckets) << shift;
+    }
+
+    static uint64_t highestOf(size_t bucket)
+    {
+        return bucket + 1 < numBuckets ? lowestOf(bucket + 1) - 1 : UINT64_MAX;
+    }
+
+    array<uint64_t, numBuckets> m_counts{};
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+};
+
+// Cache misses, dTLB read misses and page faults of the calling thread, where
+// perf_event_open is allowed. A counter the machine or the permissions don't
+// allow reads as -1.
+class PerfCounters
+{
+public:
+    static constexpr size_t numCounters = 3;
+
+    PerfCounters()
+    {
+#ifdef __linux__
+        m_fds[0] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        m_fds[1] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        m_fds[2] = open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (auto fd : m_fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator =(const PerfCounters&) = delete;
+
+    static const char* name(size_t counter)
+    {
+        static const char* const names[numCounters] = { "cache-misses", "dTLB-misses", "page-faults" };
+        return names[counter];
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        for (auto fd : m_fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    array<int64_t, numCounters> stop()
+    {
+        array<int64_t, numCounters> values;
+        values.fill(-1);
+#ifdef __linux__
+        for (size_t i = 0; i < numCounters; ++i) {
+            uint64_t value;
+            if (m_fds[i] >= 0 && ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+                read(m_fds[i], &value, sizeof(value)) == sizeof(value)) {
+                values[i] = static_cast<int64_t>(value);
+            }
+        }
+#endif
+        return values;
+    }
+private:
+#ifdef __linux__
+    static int open(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    array<int, numCounters> m_fds{ { -1, -1, -1 } };
+};
+
+struct Sample
+{
+    uint64_t time;
+    uint32_t paths;
+};
+
+// Times `op' on its own and records the paths it took. The calls are kept
+// apart so that the tail can be split by path once the phase is over.
+class Phase
+{
+public:
+    Phase(const string& name, size_t expectedOps)
+        : m_name(name)
+    {
+        m_samples.reserve(expectedOps);
+        m_counters.start();
+    }
+
+    template<typename Op>
+    auto time(Op&& op)
+    {
+        memory::tracedPaths = 0;
+        auto start = startTimer();
+        auto result = op();
+        auto stop = stopTimer();
+        m_samples.push_back({ stop - start, memory::tracedPaths });
+        return result;
+    }
+
+    // prints the percentiles, counters and paths of the calls so far
+    void report()
+    {
+        auto counters = m_counters.stop();
+        Histogram all;
+        for (auto& s : m_samples) {
+            all.record(s.time);
+        }
+        auto ops = all.count();
+        cout << m_name << ": " << ops << " ops, " << timeUnit
+             << " p50 " << all.percentile(50) << " p99 " << all.percentile(99)
+             << " p99.9 " << all.percentile(99.9) << " p99.99 " << all.percentile(99.99)
+             << " max " << all.max() << "\n   ";
+        for (size_t i = 0; i < PerfCounters::numCounters; ++i) {
+            cout << " " << PerfCounters::name(i) << " ";
+            if (counters[i] < 0) {
+                cout << "n/a";
+            } else {
+                cout << fixed << setprecision(3) << double(counters[i]) / max<uint64_t>(ops, 1) << "/op";
+            }
+        }
+        cout << "\n";
+
+        // the calls at or above p99.9, and the paths they took
+        auto tailFrom = all.percentile(99.9);
+        size_t tailOps = 0;
+        size_t untracedTailOps = 0;
+        array<Histogram, static_cast<size_t>(memory::TracePath::count)> byPath;
+        array<size_t, static_cast<size_t>(memory::TracePath::count)> tailByPath{};
+        for (auto& s : m_samples) {
+            bool tail = s.time >= tailFrom;
+            tailOps += tail;
+            untracedTailOps += tail && !s.paths;
+            for (size_t path = 0; path < byPath.size(); ++path) {
+                if (s.paths & (1u << path)) {
+                    byPath[path].record(s.time);
+                    tailByPath[path] += tail;
+                }
+            }
+        }
+        for (size_t path = 0; path < byPath.size(); ++path) {
+            auto& h = byPath[path];
+            if (h.count()) {
+                cout << "    " << left << setw(22) << memory::tracePathName(static_cast<memory::TracePath>(path))
+                     << right << " " << h.count() << " ops, p50 " << h.percentile(50) << " max " << h.max()
+                     << ", in " << fixed << setprecision(1) << 100.0 * tailByPath[path] / max<size_t>(tailOps, 1)
+                     << "% of the tail\n";
+            }
+        }
+        cout << "    " << left << setw(22) << "(no traced path)" << right << " in " << fixed << setprecision(1)
+             << 100.0 * untracedTailOps / max<size_t>(tailOps, 1) << "% of the tail\n";
+        cout.unsetf(ios::floatfield);
+    }
+private:
+    string m_name;
+    vector<Sample> m_samples;
+    PerfCounters m_counters;
+};
+
+// Fills the allocator with up to `numBlocks' blocks of random sizes, frees
+// half of them in random order, churns around what is left and frees the
+// rest, each step as a phase of its own.
+template<typename Malloc, typename Free>
+void runPhases(const string& name, Malloc&& malloc, Free&& free, size_t minSize, size_t maxSize,
+               size_t numBlocks, size_t churnOps)
+{
+    mt19937 rng(42);
+    uniform_int_distribution<size_t> sizes(minSize, maxSize);
+    vector<void*> live;
+    live.reserve(numBlocks);
+
+    {
+        Phase phase(name + " malloc", numBlocks);
+        for (size_t i = 0; i < numBlocks; ++i) {
+            auto size = sizes(rng);
+            if (auto p = phase.time([&] { return malloc(size); })) {
+                live.push_back(p);
+            }
+        }
+        phase.report();
+    }
+
+    shuffle(live.begin(), live.end(), rng);
+    {
+        auto keep = live.size() - live.size() / 2;
+        Phase phase(name + " free", live.size() - keep);
+        while (live.size() > keep) {
+            auto p = live.back();
+            live.pop_back();
+            phase.time([&] { free(p); return 0; });
+        }
+        phase.report();
+    }
+
+    {
+        Phase phase(name + " churn", churnOps);
+        for (size_t i = 0; i < churnOps; ++i) {
+            if (i % 2 == 0 && !live.empty()) {
+                auto pos = uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+                auto p = live[pos];
+                live[pos] = live.back();
+                live.pop_back();
+                phase.time([&] { free(p); return 0; });
+            } else {
+                auto size = sizes(rng);
+                if (auto p = phase.time([&] { return malloc(size); })) {
+                    live.push_back(p);
+                }
+            }
+        }
+        phase.report();
+    }
+
+    {
+        Phase phase(name + " drain", live.size());
+        for (auto p : live) {
+            phase.time([&] { free(p); return 0; });
+        }
+        phase.report();
+    }
+    cout << "\n";
+}
+
+// what a timer reads around nothing, to subtract from the rest by eye
+void benchmarkTimer()
+{
+    Phase phase("timer", 1000000);
+    for (int i = 0; i < 1000000; ++i) {
+        phase.time([] { return 0; });
+    }
+    phase.report();
+    cout << "\n";
+}
+
+template<typename Allocator>
+void runSegregated(const string& name, Allocator& allocator)
+{
+    runPhases(name, [&](size_t size) { return allocator.malloc(size); },
+              [&](void* p) { allocator.free(p); }, 1, allocator.maxBinSize(), 200000, 400000);
+}
+
+void benchmarkSegregated()
+{
+    memory::SegregatedAllocator<16> allocator(16, 16);
+    runSegregated("segregated", allocator);
+}
+
+// with prefaulted pages topped up from the background
+void benchmarkSegregatedReserve()
+{
+    memory::SegregatedAllocator<16> allocator(16, 16);
+    allocator.reserveInBackground(16);
+    runSegregated("segregated_reserve", allocator);
+    allocator.reserveInBackground(0);
+}
+
+void benchmarkSegregatedBitmap()
+{
+    memory::SegregatedAllocator<16, memory::BitmapSlab> allocator(16, 16);
+    runSegregated("segregated_bitmap", allocator);
+}
+
+// one thread only, what the lookup of the heap of the thread adds
+void benchmarkThreadHeaps()
+{
+    memory::ThreadHeaps<memory::SegregatedAllocator<16>> heaps(16, 16);
+    runPhases("thread_heaps", [&](size_t size) { return heaps.malloc(size); },
+              [&](void* p) { heaps.free(p); }, 1, heaps.local().maxBinSize(), 200000, 400000);
+}
+
+template<typename Allocator>
+void runLarge(const string& name, typename Allocator::FitPolicy policy)
+{
+    constexpr size_t arenaSize = 1024 * 1024 * 1024;
+    auto arena = static_cast<char*>(memory::vmAllocate(arenaSize));
+    Allocator allocator(arena, arena + arenaSize, 0, true, policy);
+    runPhases(name, [&](size_t size) { return allocator.malloc(size); },
+              [&](void* p) { allocator.free(p); }, 16, 64 * 1024, 20000, 40000);
+    memory::vmDeallocate(arena, arenaSize);
+}
+
+void benchmarkLarge()
+{
+    runLarge<memory::LargeAllocator>("large", memory::LargeAllocator::FitPolicy::bestFit);
+}
+
+void benchmarkLargeFirstFit()
+{
+    runLarge<memory::LargeAllocator>("large_first_fit", memory::LargeAllocator::FitPolicy::addressFirstFit);
+}
+
+void benchmarkCompressedLarge()
+{
+    runLarge<memory::CompressedLargeAllocator>("compressed_large",
+                                               memory::CompressedLargeAllocator::FitPolicy::bestFit);
+}
+
+// learning the lifetimes of requests without a hint, over three large allocators
+void benchmarkLifetime()
+{
+    constexpr size_t third = 1024 * 1024 * 1024;
+    constexpr size_t arenaSize = 3 * third;
+    auto arena = static_cast<char*>(memory::vmAllocate(arenaSize));
+    memory::LargeAllocator shortLived(arena, arena + third, 0, true);
+    memory::LargeAllocator longLived(arena + third, arena + 2 * third, 0, true);
+    memory::LargeAllocator unknown(arena + 2 * third, arena + arenaSize, 0, true);
+    {
+        memory::LifetimeAllocator<memory::LargeAllocator> allocator(shortLived, longLived, unknown);
+        allocator.enableLearning();
+        runPhases("lifetime", [&](size_t size) { return allocator.malloc(size); },
+                  [&](void* p) { allocator.free(p); }, 16, 64 * 1024, 20000, 40000);
+    }
+    memory::vmDeallocate(arena, arenaSize);
+}
+
+void benchmarkStripedLarge()
+{
+    memory::StripedLargeAllocator allocator(4, 256 * 1024 * 1024);
+    runPhases("striped_large", [&](size_t size) { return allocator.malloc(size); },
+              [&](void* p) { allocator.free(p); }, 16, 64 * 1024, 20000, 40000);
+}
+
+// private memory stands in for the shared mapping, the lock is the same
+void benchmarkSharedLarge()
+{
+    constexpr size_t heapSize = 1024 * 1024 * 1024;
+    auto p = memory::vmAllocate(heapSize);
+    {
+        memory::SharedLargeAllocator allocator(p, heapSize);
+        runPhases("shared_large", [&](size_t size) { return allocator.malloc(size); },
+                  [&](void* p) { allocator.free(p); }, 16, 64 * 1024, 20000, 40000);
+    }
+    memory::vmDeallocate(p, heapSize);
+}
+
+// the blocks land in the pages of a file, which are faulted in from the page cache
+void benchmarkPersistentHeap()
+{
+    char path[] = "/tmp/latency_benchmarkXXXXXX";
+    auto file = mkstemp(path);
+    if (file < 0) {
+        cout << "persistent_heap: no temporary file\n\n";
+        return;
+    }
+    close(file);
+    {
+        auto heap = memory::PersistentHeap::open(path, 1024 * 1024 * 1024);
+        if (heap.valid()) {
+            runPhases("persistent_heap", [&](size_t size) { return heap.malloc(size); },
+                      [&](void* p) { heap.free(p); }, 16, 64 * 1024, 20000, 40000);
+        }
+    }
+    remove(path);
+}
+
+void benchmarkBuddy()
+{
+    memory::BuddyAllocator allocator(1024 * 1024 * 1024, 4096);
+    runPhases("buddy", [&](size_t size) { return allocator.malloc(size); },
+              [&](void* p) { allocator.free(p); }, 4096, 64 * 1024, 20000, 40000);
+}
+
+void benchmarkHuge()
+{
+    memory::HugeAllocator allocator;
+    runPhases("huge", [&](size_t size) { return allocator.malloc(size); },
+              [&](void* p) { allocator.free(p); }, 1024 * 1024, 8 * 1024 * 1024, 2000, 4000);
+}
+
+// Nothing is freed one by one, so instead of the phases of the others each
+// request allocates a batch of blocks within a scope which rewinds the arena.
+void benchmarkMonotonicArena()
+{
+    constexpr size_t numRequests = 10000;
+    constexpr size_t blocksPerRequest = 64;
+    memory::MonotonicArena arena(1024 * 1024 * 1024);
+    mt19937 rng(42);
+    uniform_int_distribution<size_t> sizes(1, 4096);
+    {
+        // the first request of each size commits its pages
+        Phase phase("monotonic_arena malloc", numRequests * blocksPerRequest);
+        for (size_t i = 0; i < numRequests; ++i) {
+            memory::MonotonicArena::Scope scope(arena);
+            for (size_t j = 0; j < blocksPerRequest; ++j) {
+                auto size = sizes(rng);
+                phase.time([&] { return arena.malloc(size); });
+            }
+        }
+        phase.report();
+    }
+    {
+        Phase phase("monotonic_arena request", numRequests);
+        for (size_t i = 0; i < numRequests; ++i) {
+            phase.time([&] {
+                memory::MonotonicArena::Scope scope(arena);
+                for (size_t j = 0; j < blocksPerRequest; ++j) {
+                    arena.malloc(sizes(rng));
+                }
+                return 0;
+            });
+        }
+        phase.report();
+    }
+    {
+        Phase phase("monotonic_arena reset", 1);
+        phase.time([&] { arena.reset(0); return 0; });
+        phase.report();
+    }
+    cout << "\n";
+}
+
+void benchmarkObjectPool()
+{
+    using Object = array<char, 64>;
+    memory::ObjectPool<Object> pool;
+    runPhases("object_pool", [&](size_t) { return static_cast<void*>(pool.create()); },
+              [&](void* p) { pool.destroy(static_cast<Object*>(p)); }, 64, 64, 200000, 400000);
+}
+
+struct Benchmark
+{
+    string name;
+    void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+    { "timer", benchmarkTimer },
+    { "segregated", benchmarkSegregated },
+    { "segregated_reserve", benchmarkSegregatedReserve },
+    { "segregated_bitmap", benchmarkSegregatedBitmap },
+    { "thread_heaps", benchmarkThreadHeaps },
+    { "large", benchmarkLarge },
+    { "large_first_fit", benchmarkLargeFirstFit },
+    { "compressed_large", benchmarkCompressedLarge },
+    { "lifetime", benchmarkLifetime },
+    { "striped_large", benchmarkStripedLarge },
+    { "shared_large", benchmarkSharedLarge },
+    { "persistent_heap", benchmarkPersistentHeap },
+    { "buddy", benchmarkBuddy },
+    { "huge", benchmarkHuge },
+    { "monotonic_arena", benchmarkMonotonicArena },
+    { "object_pool", benchmarkObjectPool },
+};
+
+} // namespace
+
+// runs every benchmark, or only the ones named on the command line
+int main(int argc, const char* argv[])
+{
+    for (auto& b : benchmarks) {
+        if (argc == 1 || find_if(argv + 1, argv + argc, [&](const char* arg) {
+                return b.name == string(arg);
+            }) != argv + argc) {
+            b.run();
+        }
+    }
+}
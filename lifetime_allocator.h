@@ -0,0 +1,226 @@
+//
+//  lifetime_allocator.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef LIFETIME_ALLOCATOR_H
+#define LIFETIME_ALLOCATOR_H
+
+#include "allocator_composition.h"
+#include "memory_utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace memory
+{
+
+// how long the caller expects a block to live
+enum class Lifetime {
+    unknown,
+    shortLived,
+    longLived
+};
+
+// Routes requests to a separate allocator per expected lifetime, so a few
+// long lived blocks don't pin the pages, or split the free ranges, that short
+// lived ones keep recycling. The same allocator may be passed for several
+// lifetimes, e.g. long lived and unknown.
+//
+// Allocators which can tell their blocks apart are freed to with free(p),
+// the others with free(p, hint) and the hint the block was allocated with.
+// The learning mode needs the former: it samples one in `sampleRate' of the
+// requests without a hint, measures how many requests later each sampled
+// block is freed, and from then on routes the sizes of the same power of two
+// by what it saw.
+template<typename Allocator>
+class LifetimeAllocator
+{
+public:
+    LifetimeAllocator(Allocator& shortLived, Allocator& longLived, Allocator& unknown)
+        : m_allocators{ &unknown, &shortLived, &longLived }
+    {
+    }
+
+    LifetimeAllocator(const LifetimeAllocator&) = delete;
+    LifetimeAllocator& operator =(const LifetimeAllocator&) = delete;
+
+    void* malloc(std::size_t size, Lifetime hint, std::size_t alignment = alignof(std::max_align_t))
+    {
+        ++m_clock;
+        if (hint != Lifetime::unknown || !m_sampleRate) {
+            return detail::allocate(allocatorFor(hint), size, alignment);
+        }
+
+        auto& bucket = m_buckets[bucketOf(size)];
+        auto p = detail::allocate(allocatorFor(bucket.learned), size, alignment);
+        if (p && ++m_sinceSample >= m_sampleRate) {
+            m_sinceSample = 0;
+            m_samples[p] = { m_clock, bucketOf(size) };
+        }
+        return p;
+    }
+
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        return malloc(size, Lifetime::unknown, alignment);
+    }
+
+    template<typename A = Allocator, typename = std::enable_if_t<detail::hasOwns<A>>>
+    void free(void* p)
+    {
+        if (!p) {
+            return;
+        }
+        if (!m_samples.empty()) {
+            recordFree(p);
+        }
+        for (auto allocator : m_allocators) {
+            if (allocator->owns(p)) {
+                allocator->free(p);
+                return;
+            }
+        }
+        assert(false && "the block doesn't belong to any of the allocators");
+    }
+
+    // `hint' is the one the block was allocated with
+    void free(void* p, Lifetime hint)
+    {
+        assert(!m_sampleRate);
+        allocatorFor(hint).free(p);
+    }
+
+    template<typename A = Allocator, typename = std::enable_if_t<detail::hasOwns<A>>>
+    bool owns(const void* p) const
+    {
+        for (auto allocator : m_allocators) {
+            if (allocator->owns(p)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Learn lifetimes of requests without a hint. A sampled block freed within
+    // `shortLifetime' requests counts as short lived, any later as long lived;
+    // one still alive after `longLifetime' requests counts without waiting.
+    void enableLearning(std::size_t sampleRate = 64,
+                        std::uint64_t shortLifetime = 1024,
+                        std::uint64_t longLifetime = 64 * 1024)
+    {
+        static_assert(detail::hasOwns<Allocator>, "learned blocks are freed without a hint");
+        assert(sampleRate && shortLifetime < longLifetime);
+        m_sampleRate = sampleRate;
+        m_shortLifetime = shortLifetime;
+        m_longLifetime = longLifetime;
+    }
+
+    // where requests of `size' bytes without a hint go
+    Lifetime learnedLifetime(std::size_t size) const
+    {
+        return m_buckets[bucketOf(size)].learned;
+    }
+private:
+    struct Sample
+    {
+        std::uint64_t birth;
+        std::size_t bucket;
+    };
+
+    struct Bucket
+    {
+        std::uint32_t numShort = 0;
+        std::uint32_t numLong = 0;
+        Lifetime learned = Lifetime::unknown;
+    };
+
+    // a bucket decides once it has seen this many samples
+    static constexpr std::uint32_t minSamples = 16;
+    // and halves its counts when it has seen this many, to follow changes
+    static constexpr std::uint32_t maxSamples = 256;
+    static constexpr std::size_t numBuckets = 64;
+
+    Allocator& allocatorFor(Lifetime lifetime)
+    {
+        return *m_allocators[static_cast<std::size_t>(lifetime)];
+    }
+
+    static std::size_t bucketOf(std::size_t size)
+    {
+        return size > 1 ? std::min<std::size_t>(64 - countLeadingZeros(size - 1), numBuckets - 1) : 0;
+    }
+
+    void recordFree(void* p)
+    {
+        auto it = m_samples.find(p);
+        if (it != m_samples.end()) {
+            auto age = m_clock - it->second.birth;
+            auto& bucket = m_buckets[it->second.bucket];
+            m_samples.erase(it);
+            if (age <= m_shortLifetime) {
+                ++bucket.numShort;
+            } else {
+                ++bucket.numLong;
+            }
+            learn(bucket);
+        }
+        // samples living on past the long lifetime count as long lived without
+        // waiting for their free, look for them now and then
+        if (m_clock - m_lastAgeScan >= m_longLifetime) {
+            m_lastAgeScan = m_clock;
+            for (auto it = m_samples.begin(); it != m_samples.end(); ) {
+                if (m_clock - it->second.birth > m_longLifetime) {
+                    auto& bucket = m_buckets[it->second.bucket];
+                    ++bucket.numLong;
+                    learn(bucket);
+                    it = m_samples.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // a lifetime is learned once 3 out of 4 samples agree
+    static void learn(Bucket& bucket)
+    {
+        auto total = bucket.numShort + bucket.numLong;
+        if (total < minSamples) {
+            return;
+        }
+        if (bucket.numShort * 4 >= total * 3) {
+            bucket.learned = Lifetime::shortLived;
+        } else if (bucket.numLong * 4 >= total * 3) {
+            bucket.learned = Lifetime::longLived;
+        } else {
+            bucket.learned = Lifetime::unknown;
+        }
+        if (total >= maxSamples) {
+            bucket.numShort /= 2;
+            bucket.numLong /= 2;
+        }
+    }
+
+    // indexed by Lifetime
+    Allocator* m_allocators[3];
+    // the number of requests so far, the unit lifetimes are measured in
+    std::uint64_t m_clock = 0;
+    std::size_t m_sampleRate = 0;
+    std::size_t m_sinceSample = 0;
+    std::uint64_t m_shortLifetime = 0;
+    std::uint64_t m_longLifetime = 0;
+    std::uint64_t m_lastAgeScan = 0;
+    std::unordered_map<const void*, Sample> m_samples;
+    Bucket m_buckets[numBuckets];
+};
+
+} // namespace memory
+
+#endif /* LIFETIME_ALLOCATOR_H */
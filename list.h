@@ -9,27 +9,33 @@
 #ifndef LIST_H
 #define LIST_H
 
+#include "intrusive_links.h"
+
 #include <algorithm>
+#include <cassert>
 
-template<typename T>
+template<typename T, typename Links = PointerLinks>
 class List;
 
-template<typename T>
+// Links selects how the nodes refer to each other, see intrusive_links.h. A
+// List of them has to use the same, and with CompressedLinks lie within reach
+// of its nodes too.
+template<typename T, typename Links = PointerLinks>
 class ListNode
 {
-    friend class List<T>;
+    friend class List<T, Links>;
 public:
-    T* prev() const { return m_prev; }
-    T* next() const { return m_next; }
+    T* prev() const { return m_prev.get(); }
+    T* next() const { return m_next.get(); }
 private:
-    void setPrev(T* p) { m_prev = p; }
-    void setNext(T* p) { m_next = p; }
+    void setPrev(T* p) { m_prev.set(p); }
+    void setNext(T* p) { m_next.set(p); }
     
-    T* m_prev = nullptr;
-    T* m_next = nullptr;
+    typename Links::template Link<T> m_prev;
+    typename Links::template Link<T> m_next;
 };
 
-template<typename T>
+template<typename T, typename Links>
 class List
 {
 public:
@@ -51,36 +57,45 @@ public:
     
     void swap(List& rhs)
     {
-        std::swap(m_head, rhs.m_head);
-        std::swap(m_tail, rhs.m_tail);
+        // the links may be relative to where they are, swap what they point to
+        auto head = rhs.first();
+        auto tail = rhs.last();
+        rhs.m_head.set(first());
+        rhs.m_tail.set(last());
+        m_head.set(head);
+        m_tail.set(tail);
     }
 
-    T* first() { return m_head; }
-    T* last() { return m_tail; }
+    bool empty() const { return !first(); }
+    
+    T* first() { return m_head.get(); }
+    T* last() { return m_tail.get(); }
     
-    const T* first() const { return m_head; }
-    const T* last() const { return m_tail; }
+    const T* first() const { return m_head.get(); }
+    const T* last() const { return m_tail.get(); }
     
     void addFirst(T& node)
     {
-        node.setNext(m_head);
-        if (m_head) {
-            m_head->setPrev(&node);
+        auto head = first();
+        node.setNext(head);
+        if (head) {
+            head->setPrev(&node);
         } else {
-            m_tail = &node;
+            m_tail.set(&node);
         }
-        m_head = &node;
+        m_head.set(&node);
     }
     
     void addLast(T& node)
     {
-        node.setPrev(m_tail);
-        if (m_tail) {
-            m_tail->setNext(&node);
+        auto tail = last();
+        node.setPrev(tail);
+        if (tail) {
+            tail->setNext(&node);
         } else {
-            m_head = &node;
+            m_head.set(&node);
         }
-        m_tail = &node;
+        m_tail.set(&node);
     }
     
     void insertAfter(T& node, T& after)
@@ -102,7 +117,7 @@ public:
         assert(!node.prev() && !node.next());
         
         if (before.prev()) {
-            before.prev()->m_next = &node;
+            before.prev()->setNext(&node);
             node.setPrev(before.prev());
             node.setNext(&before);
             before.setPrev(&node);
@@ -113,16 +128,16 @@ public:
     
     void remove(T& node)
     {
-        assert(node.prev() || node.next());
+        assert(node.prev() || node.next() || first() == &node);
         
         if (!node.prev()) {
-            m_head = node.next();
+            m_head.set(node.next());
         } else {
             node.prev()->setNext(node.next());
         }
         
         if (!node.next()) {
-            m_tail = node.prev();
+            m_tail.set(node.prev());
         } else {
             node.next()->setPrev(node.prev());
         }
@@ -131,8 +146,8 @@ public:
         node.setNext(nullptr);
     }
 private:
-    T* m_head = nullptr;
-    T* m_tail = nullptr;
+    typename Links::template Link<T> m_head;
+    typename Links::template Link<T> m_tail;
 };
 
 #endif /* LIST_H */
@@ -9,13 +9,36 @@
 #include "large_allocator.h"
 #include "segregated_allocator.h"
 #include "bounded_allocator.h"
+#include "epoch_reclaimer.h"
+#include "allocator_composition.h"
+#include "lifetime_allocator.h"
+#include "huge_allocator.h"
+#include "buddy_allocator.h"
+#include "monotonic_arena.h"
+#include "object_pool.h"
+#include "persistent_heap.h"
+#include "shared_large_allocator.h"
+#include "striped_large_allocator.h"
+#include "os_memory.h"
+#include "thread_heap.h"
 #include "free_list.h"
 #include "rb_tree.h"
+#include "sample_size_classes.h"
 
+#include <atomic>
 #include <iostream>
+#include <thread>
 #include <vector>
+#include <memory>
+#include <iterator>
 #include <cstdlib>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -33,6 +56,71 @@ struct Foo : RbTreeNode
     }
 };
 
+// equal keys are chained, `id' tells them apart
+struct Dup : RbTreeChainNode
+{
+    int key;
+    int id;
+    
+    Dup(int key, int id) : key(key), id(id) {}
+    
+    bool operator <(const Dup& rhs) const
+    {
+        return key < rhs.key;
+    }
+};
+
+template<typename Tree>
+vector<int> idsOf(const Tree& tree)
+{
+    vector<int> ids;
+    for (auto& e : tree) {
+        ids.push_back(e.id);
+    }
+    return ids;
+}
+
+// keeps the largest value of its subtree
+struct Span : RbTreeNode
+{
+    int key;
+    int value;
+    int maxValue = 0;
+    
+    Span(int key, int value) : key(key), value(value) {}
+    
+    bool operator <(const Span& rhs) const
+    {
+        return key < rhs.key;
+    }
+};
+
+struct MaxValue
+{
+    void operator()(Span& span, const Span* left, const Span* right) const
+    {
+        span.maxValue = max({ span.value, left ? left->maxValue : 0, right ? right->maxValue : 0 });
+    }
+};
+
+// the span with the lowest key holding at least `value', found through the subtree maxima
+const Span* firstAtLeast(const RbTree<Span, less<Span>, MaxValue>& tree, int value)
+{
+    auto it = tree.descend([value](const Span& span, const Span* left, const Span* right) {
+        if (left && left->maxValue >= value) {
+            return RbTreeDirection::left;
+        }
+        if (span.value >= value) {
+            return RbTreeDirection::here;
+        }
+        if (right && right->maxValue >= value) {
+            return RbTreeDirection::right;
+        }
+        return RbTreeDirection::none;
+    });
+    return it != tree.end() ? &*it : nullptr;
+}
+
 template<typename It>
 void check_equal(RbTree<Foo>& tree, It beg, It end)
 {
@@ -75,6 +163,46 @@ void testRbTree()
     }
 }
 
+// every key is in the tree twice, a lookup from any hint, on either side of the
+// key or a duplicate of it, has to land where one from the root does
+template<typename Node>
+void testHintedLowerBound()
+{
+    struct Key : Node
+    {
+        int key = 0;
+        
+        Key() = default;
+        
+        Key(int key) : key(key) {}
+        
+        bool operator <(const Key& rhs) const
+        {
+            return key < rhs.key;
+        }
+    };
+    // compressed links only reach nodes close to the tree
+    struct Arena
+    {
+        RbTree<Key> tree;
+        Key keys[64];
+    };
+    auto arena = make_unique<Arena>();
+    auto& tree = arena->tree;
+    for (int i = 0; i < 64; ++i) {
+        arena->keys[i].key = i / 2 * 2;
+        tree.insert(arena->keys[i]);
+    }
+    for (int key = -1; key <= 64; ++key) {
+        auto expected = tree.lowerBound(Key(key));
+        assert(expected == tree.end() || (expected->key >= key && (expected == tree.begin() || prev(expected)->key < key)));
+        assert(tree.lowerBound(Key(key), tree.end()) == expected);
+        for (auto hint = tree.begin(); hint != tree.end(); ++hint) {
+            assert(tree.lowerBound(Key(key), hint) == expected);
+        }
+    }
+}
+
 int main(int argc, const char * argv[]) {
     constexpr int size = 1024*1024*10;
     auto buf = new char[size];
@@ -82,6 +210,7 @@ int main(int argc, const char * argv[]) {
     {
         memory::LargeAllocator allocator(buf, buf + size);
         auto p = allocator.malloc(1 * 1024 * 1024);
+        assert(allocator.usableSize(p) >= memory::LargeAllocator::goodSize(1 * 1024 * 1024));
         allocator.free(p);
         
         struct alignas(16) S {
@@ -90,8 +219,70 @@ int main(int argc, const char * argv[]) {
         
         memory::BoundedAllocator boundedAlloc(allocator);
         auto s = static_cast<S*>(boundedAlloc.malloc(sizeof(S), alignof(S)));
+        assert(boundedAlloc.usableSize(s) == sizeof(S));
         //memset(s + 1, 1, 4);
         boundedAlloc.free(s);
+        
+        // the padding before a block aligned to MaxAlign is rarely all of it
+        auto q = allocator.malloc(100, memory::MaxAlign);
+        assert(reinterpret_cast<std::uintptr_t>(q) % memory::MaxAlign == 0);
+        assert(allocator.usableSize(q) >= 100 && allocator.usableSize(q) < 100 + memory::MaxAlign);
+        allocator.free(q);
+        auto r = allocator.malloc(100, memory::MaxAlign);
+        assert(r == q);
+        allocator.free(r);
+    }
+    
+    {
+        memory::LargeAllocator allocator(buf, buf + size, 0, false, memory::LargeAllocator::FitPolicy::addressFirstFit);
+        auto a = allocator.malloc(4096);
+        auto b = allocator.malloc(1024);
+        auto c = allocator.malloc(256);
+        allocator.malloc(16);
+        allocator.free(c);
+        allocator.free(a);
+        // first fit takes the lowest block large enough, best fit would take c's
+        auto d = allocator.malloc(256);
+        assert(d == a);
+        allocator.free(d);
+        allocator.free(b);
+    }
+    
+    {
+        const std::size_t arenaSize = 64 * 1024 * 1024;
+        const std::size_t mb = 1024 * 1024;
+        auto arena = static_cast<char*>(memory::vmAllocate(arenaSize));
+        memory::LargeAllocator allocator(arena, arena + arenaSize, 0, true);
+        auto resident = [](char* p) {
+            unsigned char pages = 0;
+            mincore(memory::roundDownPowerOfTwo(p, memory::vmPageSize()), 1, &pages);
+            return pages & 1;
+        };
+        auto a = static_cast<char*>(allocator.malloc(mb));
+        auto b = static_cast<char*>(allocator.malloc(16 * mb));
+        std::memset(a, 1, mb);
+        std::memset(b, 1, 16 * mb);
+        allocator.free(b);
+        assert(allocator.purge() >= 15 * mb && !resident(b + 4 * mb));
+        // merged with the purged block behind it, only the dirty front is zeroed again
+        allocator.free(a);
+        auto c = static_cast<char*>(allocator.calloc(8, mb));
+        assert(c == a && !resident(c + 4 * mb));
+        assert(!c[0] && !c[mb - 1] && !c[mb + 64] && !c[4 * mb] && !c[8 * mb - 1]);
+        allocator.free(c);
+        memory::vmDeallocate(arena, arenaSize);
+    }
+    
+    {
+        memory::CompressedLargeAllocator allocator(buf, buf + size);
+        auto a = allocator.malloc(4096);
+        auto b = allocator.malloc(100, 64);
+        assert(reinterpret_cast<std::uintptr_t>(b) % 64 == 0 && allocator.usableSize(b) >= 100);
+        allocator.free(a);
+        allocator.free(b);
+        auto c = allocator.malloc(size / 2);
+        assert(c && allocator.owns(c));
+        allocator.free(c);
     }
     
     {
@@ -101,9 +292,663 @@ int main(int argc, const char * argv[]) {
     
     {
         memory::SegregatedAllocator<1> allocator(8, 8);
-        allocator.free(allocator.malloc(7));
+        auto p = allocator.malloc(7);
+        assert(allocator.usableSize(p) == allocator.goodSize(7));
+        allocator.free(p);
+        auto q = static_cast<char*>(allocator.calloc(1, 8));
+        assert(q[0] == 0);
+        allocator.free(q);
         allocator.malloc(9);
     }
+    
+    {
+        // classes generated by size_class_gen from sample_sizes.txt, which has requests too large for them
+        using Sample = memory::SegregatedAllocator<memory::SampleSizeClasses::count(), memory::FreeList,
+                                                   memory::SampleSizeClasses>;
+        Sample allocator;
+        assert(allocator.goodSize(24) == 24 && allocator.goodSize(1000) >= 1000 && !allocator.goodSize(4000));
+        auto p = allocator.malloc(1000);
+        auto q = allocator.malloc(1000);
+        assert(p && q && allocator.pageCount() == 1);
+        allocator.free(p);
+        allocator.free(q);
+    }
+    
+    {
+        // the classes whose blocks don't fit a page are never served
+        memory::SegregatedAllocator<4> allocator(8, 2048);
+        assert(allocator.goodSize(2000) && !allocator.goodSize(4000));
+        assert(!allocator.malloc(4000) && !allocator.pageCount());
+    }
+    
+    {
+        memory::SegregatedAllocator<4, memory::BitmapSlab> allocator(8, 8);
+        void* blocks[16];
+        auto n = allocator.mallocBatch(16, blocks, 16);
+        assert(n == 16);
+        for (std::size_t i = 0; i < n; ++i) {
+            allocator.free(blocks[i]);
+        }
+    }
+    
+    {
+        memory::SegregatedAllocator<4, memory::BitmapSlab> allocator(8, 8);
+        if (allocator.enableMeshing()) {
+            vector<void*> blocks;
+            for (int i = 0; i < 4096; ++i) {
+                blocks.push_back(allocator.malloc(32));
+            }
+            for (std::size_t i = 0; i < blocks.size(); ++i) {
+                if (i % 16) {
+                    allocator.free(blocks[i]);
+                }
+            }
+            auto pages = allocator.pageCount();
+            assert(allocator.mesh() && allocator.pageCount() < pages);
+            for (std::size_t i = 0; i < blocks.size(); i += 16) {
+                allocator.free(blocks[i]);
+            }
+        }
+    }
+    
+    {
+        using Meshing = memory::SegregatedAllocator<4, memory::BitmapSlab>;
+        Meshing allocator(8, 8);
+        Meshing other(8, 8);
+        if (allocator.enableMeshing()) {
+            vector<void*> blocks;
+            for (int i = 0; i < 4096; ++i) {
+                blocks.push_back(allocator.malloc(32));
+            }
+            vector<void*> survivors;
+            for (std::size_t i = 0; i < blocks.size(); ++i) {
+                if (i % 16) {
+                    allocator.free(blocks[i]);
+                } else {
+                    survivors.push_back(blocks[i]);
+                }
+            }
+            // half of what is left freed through another heap, pending when the pages are meshed
+            for (std::size_t i = 0; i < survivors.size(); i += 2) {
+                other.free(survivors[i]);
+            }
+            assert(allocator.mesh());
+            for (std::size_t i = 1; i < survivors.size(); i += 2) {
+                allocator.free(survivors[i]);
+            }
+            allocator.collect();
+            assert(allocator.pageCount() <= 1);
+        }
+    }
+
+    {
+        memory::SegregatedAllocator<4> allocator(8, 8);
+        assert(allocator.reserve(1, 4) == 4 && allocator.reserve(1, 2) == 4);
+        vector<void*> blocks;
+        // pages come from the reserve until it runs out, zero filled like fresh ones
+        for (int i = 0; i < 4096; ++i) {
+            auto p = static_cast<char*>(allocator.calloc(1, 16));
+            assert(p && !p[15]);
+            blocks.push_back(p);
+        }
+        for (auto p : blocks) {
+            allocator.free(p);
+        }
+        
+        // callers topping up the same bin at once don't map more than asked for
+        vector<thread> reservers;
+        for (int i = 0; i < 4; ++i) {
+            reservers.emplace_back([&] { allocator.reserve(2, 8); });
+        }
+        for (auto& t : reservers) {
+            t.join();
+        }
+        assert(allocator.readyPageCount(2) == 8);
+        
+        allocator.reserveInBackground(2, std::chrono::milliseconds(1));
+        while (allocator.readyPageCount(0) < 2) {
+            std::this_thread::yield();
+        }
+        allocator.free(allocator.malloc(8));
+        allocator.reserveInBackground(0);
+    }
+
+    {
+        memory::ThreadHeaps<memory::SegregatedAllocator<4>> heaps(8, 8);
+        vector<void*> blocks;
+        // the pages still in use are abandoned when the thread exits
+        thread([&] {
+            for (int i = 0; i < 1024; ++i) {
+                blocks.push_back(heaps.malloc(16));
+            }
+        }).join();
+        for (auto p : blocks) {
+            heaps.free(p);
+        }
+        // and adopted on the next page miss
+        heaps.free(heaps.malloc(16));
+    }
+    
+    {
+        memory::SegregatedAllocator<4> allocator(8, 8);
+        vector<void*> blocks;
+        while (allocator.pageCount() < 3) {
+            blocks.push_back(allocator.malloc(32));
+        }
+        auto pageOf = [](void* p) {
+            return memory::roundDownPowerOfTwo(p, memory::vmPageSize());
+        };
+        // the first page full, the second with one block in use, the third empty
+        allocator.free(blocks.back());
+        blocks.pop_back();
+        auto second = pageOf(blocks.back());
+        while (pageOf(blocks[blocks.size() - 2]) == second) {
+            allocator.free(blocks[blocks.size() - 2]);
+            blocks.erase(blocks.end() - 2);
+        }
+        assert(allocator.pageCount() == 3);
+        // the last block of the second page freed through another heap empties
+        // it, which is noticed when it is picked
+        memory::SegregatedAllocator<4> other(8, 8);
+        other.free(blocks.back());
+        blocks.pop_back();
+        blocks.push_back(allocator.malloc(32));
+        assert(allocator.pageCount() == 2);
+        for (auto p : blocks) {
+            allocator.free(p);
+        }
+    }
+    
+    {
+        using Meshing = memory::SegregatedAllocator<4, memory::BitmapSlab>;
+        Meshing::AbandonedPool pool;
+        vector<void*> blocks;
+        {
+            Meshing allocator(8, 8);
+            allocator.setAbandonedPool(&pool);
+            if (allocator.enableMeshing()) {
+                vector<void*> all;
+                for (int i = 0; i < 4096; ++i) {
+                    all.push_back(allocator.malloc(32));
+                }
+                for (std::size_t i = 0; i < all.size(); ++i) {
+                    if (i % 16) {
+                        allocator.free(all[i]);
+                    } else {
+                        blocks.push_back(all[i]);
+                    }
+                }
+                assert(allocator.mesh());
+                // meshed pages, still in use, outlive the heap
+                allocator.abandon();
+            }
+        }
+        {
+            // and the pool releases them along with their aliases and the page file
+            Meshing allocator(8, 8);
+            allocator.setAbandonedPool(&pool);
+            if (allocator.enableMeshing()) {
+                for (std::size_t i = 0; i < blocks.size() / 2; ++i) {
+                    allocator.free(blocks[i]);
+                }
+                // adopted pages aren't meshed into the page file of the heap
+                allocator.free(allocator.malloc(32));
+                allocator.mesh();
+            }
+        }
+    }
+    
+    {
+        memory::HugeAllocator allocator;
+        auto p = static_cast<char*>(allocator.malloc(4 * 1024 * 1024));
+        p[0] = 1;
+        p = static_cast<char*>(allocator.realloc(p, 64 * 1024 * 1024));
+        assert(p[0] == 1 && allocator.usableSize(p) >= 64 * 1024 * 1024);
+        allocator.free(p);
+    }
+
+    {
+        using Heaps = memory::ThreadHeaps<memory::SegregatedAllocator<4>>;
+        // counts the blocks handed back
+        struct CountingHeaps
+        {
+            Heaps heaps{ 8, 8 };
+            std::atomic<std::size_t> freed{ 0 };
+            
+            void free(void* p) { ++freed; heaps.free(p); }
+            void freeBatch(void* const* blocks, std::size_t count)
+            {
+                freed += count;
+                heaps.freeBatch(blocks, count);
+            }
+        } counting;
+        {
+            memory::EpochReclaimer<CountingHeaps> epochs(counting, 4);
+            std::atomic<int> step{ 0 };
+            // a reader still inside its critical section holds the block back
+            thread reader([&] {
+                memory::EpochReclaimer<CountingHeaps>::Guard guard(epochs);
+                step = 1;
+                while (step != 2) {
+                    std::this_thread::yield();
+                }
+            });
+            while (step != 1) {
+                std::this_thread::yield();
+            }
+            epochs.retire(counting.heaps.malloc(16));
+            for (int i = 0; i < 8; ++i) {
+                epochs.collect();
+            }
+            assert(!counting.freed);
+            step = 2;
+            reader.join();
+            while (!epochs.collect()) {
+            }
+            assert(counting.freed == 1);
+            
+            // the batches left by exited threads go with the reclaimer
+            thread([&] {
+                for (int i = 0; i < 1000; ++i) {
+                    memory::EpochReclaimer<CountingHeaps>::Guard guard(epochs);
+                    epochs.retire(counting.heaps.malloc(16));
+                }
+            }).join();
+        }
+        assert(counting.freed == 1001);
+    }
+
+    {
+        memory::StripedLargeAllocator allocator(4, 16 * 1024 * 1024);
+        vector<void*> blocks(4);
+        vector<thread> threads;
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            threads.emplace_back([&, i] {
+                for (int j = 0; j < 1000; ++j) {
+                    allocator.free(allocator.malloc(4096 + j));
+                }
+                blocks[i] = allocator.calloc(1, 4096);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        // blocks go back to the arena they came from whichever thread frees them
+        for (auto p : blocks) {
+            assert(allocator.owns(p) && static_cast<char*>(p)[0] == 0);
+            allocator.free(p);
+        }
+    }
+
+    {
+        // two mappings of the same pages stand in for two processes
+        constexpr std::size_t heapSize = 16 * 1024 * 1024;
+        auto file = memory::vmCreatePageFile();
+        if (file >= 0 && memory::vmResizePageFile(file, heapSize)) {
+            auto producerView = memory::vmMapPageFile(file, 0, heapSize);
+            auto consumerView = memory::vmMapPageFile(file, 0, heapSize);
+            memory::SharedLargeAllocator producer(producerView, heapSize);
+            auto consumer = memory::SharedLargeAllocator::attach(consumerView, heapSize);
+            assert(consumer.valid());
+            
+            auto message = static_cast<char*>(producer.malloc(1024 * 1024));
+            message[0] = 42;
+            auto received = static_cast<char*>(consumer.at(producer.offsetOf(message)));
+            assert(received[0] == 42 && consumer.usableSize(received) >= 1024 * 1024);
+            consumer.free(received);
+            // the block went back to the heap both see
+            assert(producer.malloc(1024 * 1024) == message);
+            
+            auto a = producer.malloc(1024 * 1024);
+            producer.malloc(64);
+            producer.free(a);
+            // another process dies holding the mutex, after a malloc split the
+            // block of `a' but before it linked the rest in
+            auto child = fork();
+            if (!child) {
+                // the mutex follows the magic, the size and the minimum block size
+                pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(static_cast<std::uint64_t*>(consumerView) + 3));
+                *(static_cast<std::uint64_t*>(memory::getUnalignedAlloc(a)) - 2) -= 4096;
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(child, &status, 0);
+            assert(WIFEXITED(status) && !WEXITSTATUS(status));
+            // the next one to take the mutex recovers the heap
+            assert(producer.malloc(1024 * 1024) == a);
+            
+            memory::vmDeallocate(producerView, heapSize);
+            memory::vmDeallocate(consumerView, heapSize);
+            memory::vmClosePageFile(file);
+        }
+    }
+
+    {
+        char path[] = "/tmp/persistent_heapXXXXXX";
+        auto file = mkstemp(path);
+        if (file >= 0) {
+            close(file);
+            const std::size_t heapSize = 16 * 1024 * 1024;
+            {
+                auto heap = memory::PersistentHeap::open(path, heapSize);
+                assert(heap.valid() && !heap.recovered() && !heap.root("greeting"));
+                auto greeting = static_cast<char*>(heap.malloc(64));
+                std::strcpy(greeting, "hello");
+                heap.setRoot("greeting", greeting);
+                heap.free(heap.malloc(1024 * 1024));
+                assert(heap.checkpoint());
+            }
+            {
+                // mapped again, maybe elsewhere
+                auto heap = memory::PersistentHeap::open(path, 0);
+                assert(heap.valid() && !heap.recovered());
+                auto greeting = static_cast<char*>(heap.root("greeting"));
+                assert(greeting && !std::strcmp(greeting, "hello") && heap.usableSize(greeting) >= 64);
+                heap.setRoot("greeting", nullptr);
+                heap.free(greeting);
+                assert(!heap.root("greeting") && heap.malloc(heapSize / 2));
+            }
+            std::remove(path);
+            
+            // runs `work' on the heap in a child which exits without closing it
+            auto crashWith = [&](auto work) {
+                auto child = fork();
+                if (!child) {
+                    auto heap = memory::PersistentHeap::open(path, heapSize);
+                    work(heap);
+                    _exit(0);
+                }
+                int status = 0;
+                waitpid(child, &status, 0);
+                assert(WIFEXITED(status) && !WEXITSTATUS(status));
+            };
+            // the header word holding the size and the flags of the block of
+            // `p', the last but one of the header
+            auto sizeWordOf = [](void* p) {
+                return static_cast<std::uint64_t*>(memory::getUnalignedAlloc(p)) - 2;
+            };
+            
+            crashWith([&](memory::PersistentHeap& heap) {
+                auto greeting = static_cast<char*>(heap.malloc(64));
+                std::strcpy(greeting, "hello");
+                heap.setRoot("greeting", greeting);
+                auto a = heap.malloc(1024 * 1024);
+                auto b = heap.malloc(1024 * 1024);
+                heap.setRoot("a", a);
+                heap.malloc(64);
+                heap.free(a);
+                // what a free of `b' leaves if it stops before coalescing
+                *sizeWordOf(b) |= std::uint64_t(1) << 62;
+            });
+            {
+                auto heap = memory::PersistentHeap::open(path, 0);
+                assert(heap.valid() && heap.recovered());
+                auto greeting = static_cast<char*>(heap.root("greeting"));
+                assert(greeting && !std::strcmp(greeting, "hello"));
+                // the two free blocks were merged, best fit takes them over the rest of the heap
+                auto a = heap.root("a");
+                auto p = heap.malloc(2 * 1024 * 1024);
+                assert(p == a);
+                heap.free(p);
+                heap.setRoot("a", nullptr);
+                p = heap.malloc(heapSize / 2);
+                assert(p);
+                heap.free(p);
+            }
+            {
+                // closed after the recovery
+                auto heap = memory::PersistentHeap::open(path, 0);
+                assert(heap.valid() && !heap.recovered() && heap.root("greeting"));
+            }
+            
+            crashWith([&](memory::PersistentHeap& heap) {
+                heap.malloc(1024);
+                auto a = heap.malloc(1024 * 1024);
+                heap.setRoot("a", a);
+                heap.malloc(64);
+                heap.free(a);
+                // what a malloc splitting the block of `a' leaves if it stops
+                // before the rest is linked in
+                *sizeWordOf(a) -= 4096;
+            });
+            {
+                auto heap = memory::PersistentHeap::open(path, 0);
+                assert(heap.valid() && heap.recovered());
+                // the block is whole again, and free
+                auto a = heap.root("a");
+                auto p = heap.malloc(1024 * 1024);
+                assert(p == a);
+                heap.setRoot("a", nullptr);
+                heap.free(p);
+            }
+            
+            crashWith([&](memory::PersistentHeap& heap) {
+                heap.malloc(1024);
+                auto p = static_cast<char*>(heap.malloc(1024));
+                // the links of the header point nowhere
+                std::memset(static_cast<char*>(memory::getUnalignedAlloc(p)) - 40, 0xff, 40);
+            });
+            assert(!memory::PersistentHeap::open(path, 0).valid());
+            std::remove(path);
+            
+            // beyond the reach of the links
+            assert(!memory::PersistentHeap::open(path, std::size_t(8) * 1024 * 1024 * 1024).valid());
+            std::remove(path);
+        }
+    }
+
+    {
+        memory::MonotonicArena arena(64 * 1024 * 1024);
+        auto p = static_cast<char*>(arena.malloc(100));
+        {
+            memory::MonotonicArena::Scope scope(arena);
+            auto q = static_cast<double*>(arena.malloc(1024 * 1024, 64));
+            assert(memory::isAligned(q) && reinterpret_cast<std::uintptr_t>(q) % 64 == 0);
+            q[1024] = 1;
+        }
+        assert(arena.used() == 100 && arena.highWater() > 1024 * 1024);
+        p[99] = 1;
+        // beyond the alignment of the pages
+        auto huge = arena.malloc(64, 2 * 1024 * 1024);
+        assert(huge && reinterpret_cast<std::uintptr_t>(huge) % (2 * 1024 * 1024) == 0);
+        arena.reset(0);
+        assert(!arena.used() && !arena.committed());
+        assert(!arena.malloc(128 * 1024 * 1024));
+    }
+
+    {
+        static int alive = 0;
+        struct alignas(32) Entity
+        {
+            Entity(int id) : id(id) { ++alive; }
+            ~Entity() { --alive; }
+            int id;
+        };
+        
+        memory::ObjectPool<Entity> pool(4096);
+        vector<Entity*> entities;
+        for (int i = 0; i < 1000; ++i) {
+            entities.push_back(pool.create(i));
+            assert(memory::isAligned(entities.back()) && entities.back()->id == i);
+        }
+        for (std::size_t i = 0; i < entities.size(); i += 2) {
+            pool.destroy(entities[i]);
+        }
+        assert(alive == 500);
+        pool.destroyAll();
+        assert(alive == 0);
+        pool.destroy(pool.create(1));
+    }
+
+    {
+        memory::BuddyAllocator allocator(1024 * 1024);
+        auto p = allocator.malloc(5000);
+        assert(allocator.usableSize(p) == 8192 && reinterpret_cast<std::uintptr_t>(p) % 8192 == 0);
+        auto q = allocator.malloc(64 * 1024);
+        assert(reinterpret_cast<std::uintptr_t>(q) % (64 * 1024) == 0);
+        allocator.free(p);
+        allocator.free(q);
+        // everything merged back into one block
+        p = allocator.malloc(1024 * 1024);
+        assert(p && !allocator.malloc(1));
+        allocator.free(p);
+    }
+
+    {
+        using Small = memory::SegregatedAllocator<16>;
+        using Large = memory::Fallback<memory::LargeAllocator, memory::BuddyAllocator>;
+        using Heap = memory::Segregator<256, Small, Large>;
+        
+        Small small(16, 16);
+        memory::LargeAllocator arena(buf, buf + size);
+        memory::BuddyAllocator buddy(64 * 1024 * 1024);
+        Large large(arena, buddy);
+        Heap heap(small, large);
+        memory::StatisticsAllocator<Heap, true> stats(heap);
+        
+        auto a = stats.malloc(100);
+        auto b = stats.malloc(1024 * 1024);
+        // more than the arena holds, served by the buddy allocator
+        auto c = stats.malloc(32 * 1024 * 1024);
+        assert(a && b && c && !arena.owns(c) && buddy.owns(c));
+        assert(stats.usableSize(c) == 32 * 1024 * 1024 && stats.mallocs() == 3);
+        stats.free(a);
+        stats.free(b);
+        stats.free(c);
+        assert(stats.frees() == 3 && !stats.bytesInUse());
+        
+        memory::AlignedAllocator<Small, 64> aligned(small);
+        auto d = aligned.malloc(24);
+        assert(reinterpret_cast<std::uintptr_t>(d) % 64 == 0 && aligned.usableSize(d) >= 24);
+        aligned.free(d);
+        
+        // bins large enough for the padding of MaxAlign
+        Small wide(64, 64);
+        memory::AlignedAllocator<Small, memory::MaxAlign> maxAligned(wide);
+        auto e = maxAligned.malloc(24);
+        assert(reinterpret_cast<std::uintptr_t>(e) % memory::MaxAlign == 0);
+        assert(maxAligned.usableSize(e) >= 24 && maxAligned.usableSize(e) < wide.maxBinSize());
+        maxAligned.free(e);
+    }
+
+    {
+        auto third = size / 3;
+        memory::LargeAllocator shortLived(buf, buf + third);
+        memory::LargeAllocator longLived(buf + third, buf + 2 * third);
+        memory::LargeAllocator unknown(buf + 2 * third, buf + size);
+        memory::LifetimeAllocator<memory::LargeAllocator> allocator(shortLived, longLived, unknown);
+        
+        auto p = allocator.malloc(100, memory::Lifetime::shortLived);
+        auto q = allocator.malloc(100, memory::Lifetime::longLived);
+        assert(shortLived.owns(p) && longLived.owns(q));
+        allocator.free(p);
+        allocator.free(q, memory::Lifetime::longLived);
+        
+        allocator.enableLearning(1);
+        for (int i = 0; i < 100; ++i) {
+            allocator.free(allocator.malloc(64));
+        }
+        assert(allocator.learnedLifetime(64) == memory::Lifetime::shortLived);
+        p = allocator.malloc(64);
+        assert(shortLived.owns(p));
+        allocator.free(p);
+    }
+
+    {
+        vector<Foo> f;
+        for (int i = 0; i < 1000; ++i) {
+            f.emplace_back(i / 3);
+        }
+        RbTree<Foo> tree;
+        tree.buildFromSorted(f.begin(), f.end());
+        vector<Foo*> pf;
+        for (auto& e : f) {
+            pf.push_back(&e);
+        }
+        check_equal(tree, pf.begin(), pf.end());
+        
+        RbTree<Foo> upper;
+        tree.split(Foo(100), upper);
+        assert(tree.begin()->size == 0 && upper.begin()->size == 100);
+        tree.join(upper);
+        assert(upper.empty());
+        check_equal(tree, pf.begin(), pf.end());
+        tree.remove(f[500]);
+        tree.insert(f[500]);
+    }
+
+    {
+        RbTree<Dup> tree;
+        vector<Dup> d{ { 1, 1 }, { 1, 2 }, { 1, 3 }, { 2, 4 }, { 2, 5 }, { 3, 6 } };
+        // the most recently inserted duplicate comes first
+        tree.insert(d[0]);
+        tree.insert(d[1]);
+        tree.insert(d[2]);
+        assert((idsOf(tree) == vector<int>{ 3, 2, 1 }));
+        RbTree<Dup> upper;
+        tree.split(Dup(2, 0), upper);
+        assert((idsOf(tree) == vector<int>{ 3, 2, 1 }) && upper.empty());
+        tree.split(Dup(1, 0), upper);
+        assert(tree.empty() && (idsOf(upper) == vector<int>{ 3, 2, 1 }));
+        upper.join(tree);
+        assert((idsOf(upper) == vector<int>{ 3, 2, 1 }));
+        for (auto& e : d) {
+            if (e.id <= 3) {
+                upper.remove(e);
+            }
+        }
+        
+        // a build keeps the order of equal keys, so do split and join
+        tree.buildFromSorted(d.begin(), d.end());
+        assert((idsOf(tree) == vector<int>{ 1, 2, 3, 4, 5, 6 }));
+        tree.split(Dup(2, 0), upper);
+        assert((idsOf(tree) == vector<int>{ 1, 2, 3 }) && (idsOf(upper) == vector<int>{ 4, 5, 6 }));
+        tree.join(upper);
+        assert((idsOf(tree) == vector<int>{ 1, 2, 3, 4, 5, 6 }));
+        // the nodes of the tree joined into go first among equal keys
+        Dup a(5, 1);
+        Dup b(5, 2);
+        RbTree<Dup> left;
+        RbTree<Dup> right;
+        left.insert(a);
+        right.insert(b);
+        left.join(right);
+        assert((idsOf(left) == vector<int>{ 1, 2 }));
+        left.remove(a);
+        left.remove(b);
+        tree.remove(d[1]);
+        assert((idsOf(tree) == vector<int>{ 1, 3, 4, 5, 6 }));
+    }
+    
+    {
+        vector<Span> spans;
+        for (int i = 0; i < 1000; ++i) {
+            spans.emplace_back(i, rand() % 10000);
+        }
+        // the subtree maxima have to survive a build, a split and a join
+        auto check = [&](const RbTree<Span, less<Span>, MaxValue>& tree, int from, int to) {
+            for (int value : { 0, 5000, 9000, 9990, 10000 }) {
+                auto expected = find_if(spans.begin() + from, spans.begin() + to, [&](const Span& span) {
+                    return span.value >= value;
+                });
+                auto found = firstAtLeast(tree, value);
+                assert(found == (expected != spans.begin() + to ? &*expected : nullptr));
+            }
+        };
+        RbTree<Span, less<Span>, MaxValue> tree;
+        tree.buildFromSorted(spans.begin(), spans.end());
+        check(tree, 0, 1000);
+        RbTree<Span, less<Span>, MaxValue> upper;
+        tree.split(Span(400, 0), upper);
+        check(tree, 0, 400);
+        check(upper, 400, 1000);
+        tree.join(upper);
+        check(tree, 0, 1000);
+    }
+    
+    testHintedLowerBound<RbTreeNode>();
+    testHintedLowerBound<RbTreeChainNode>();
+    testHintedLowerBound<BasicRbTreeChainNode<CompressedLinks>>();
 
     delete[] buf;
 }
@@ -11,9 +11,19 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <cassert>
 
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define MEMORY_HAS_SSE2 1
+#endif
+
 namespace memory
 {
     
@@ -86,7 +96,7 @@ inline std::ptrdiff_t pointerDistanceTo(T* p, U* q)
 template<typename T>
 inline bool isAligned(T* p)
 {
-    constexpr auto align = detail::alignment<T>();
+    constexpr auto align = detail::alignment<std::remove_cv_t<T>>();
     return (reinterpret_cast<std::uintptr_t>(p) & (align - 1)) == 0;
 }
     
@@ -118,6 +128,70 @@ inline T* roundDownPowerOfTwo(T* p, size_t align)
                     reinterpret_cast<std::uintptr_t>(p) & ~(align - 1)));
 }
 
+// index of the lowest set bit, `n' must not be 0
+inline unsigned countTrailingZeros(std::uint64_t n)
+{
+    assert(n);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, n);
+    return index;
+#else
+    return __builtin_ctzll(n);
+#endif
+}
+    
+// index of the highest set bit counted from the top, `n' must not be 0
+inline unsigned countLeadingZeros(std::uint64_t n)
+{
+    assert(n);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, n);
+    return 63 - index;
+#else
+    return __builtin_clzll(n);
+#endif
+}
+    
+inline unsigned popCount(std::uint64_t n)
+{
+#ifdef _MSC_VER
+    return static_cast<unsigned>(__popcnt64(n));
+#else
+    return __builtin_popcountll(n);
+#endif
+}
+
+// the line size assumed when laying data out for the cache
+constexpr std::size_t cacheLineSize = 64;
+
+// ranges at least this large are cleared bypassing the cache
+constexpr std::size_t nonTemporalZeroThreshold = 256 * 1024;
+
+inline void zeroMemory(void* p, std::size_t size)
+{
+#ifdef MEMORY_HAS_SSE2
+    if (size >= nonTemporalZeroThreshold) {
+        auto beg = static_cast<char*>(p);
+        auto end = beg + size;
+        auto alignedBeg = roundUpPowerOfTwo(beg, sizeof(__m128i));
+        auto alignedEnd = roundDownPowerOfTwo(end, sizeof(__m128i));
+        
+        std::memset(beg, 0, alignedBeg - beg);
+        auto zero = _mm_setzero_si128();
+        for (auto cur = alignedBeg; cur != alignedEnd; cur += sizeof(__m128i)) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(cur), zero);
+        }
+        // make the streaming stores visible before the memory is handed out
+        _mm_sfence();
+        std::memset(alignedEnd, 0, end - alignedEnd);
+        return;
+    }
+#endif
+    std::memset(p, 0, size);
+}
+
 } // namespace memory
 
 #endif /* MEMORY_UTILS_H */
@@ -0,0 +1,104 @@
+//
+//  monotonic_arena.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "monotonic_arena.h"
+#include "memory_utils.h"
+#include "os_memory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace memory
+{
+    
+MonotonicArena::MonotonicArena(std::size_t reserveSize, std::size_t commitSize)
+{
+    assert(reserveSize && commitSize);
+    m_reserved = roundUpPowerOfTwo(reserveSize, vmPageSize());
+    m_commitSize = roundUpPowerOfTwo(commitSize, vmPageSize());
+    m_base = static_cast<char*>(vmReserve(m_reserved));
+    if (!m_base) {
+        m_reserved = 0;
+    }
+}
+    
+MonotonicArena::~MonotonicArena()
+{
+    if (m_base) {
+        vmDeallocate(m_base, m_reserved);
+    }
+}
+    
+MonotonicArena::MonotonicArena(MonotonicArena&& rhs)
+{
+    swap(rhs);
+}
+    
+MonotonicArena& MonotonicArena::operator =(MonotonicArena&& rhs)
+{
+    MonotonicArena(std::move(rhs)).swap(*this);
+    return *this;
+}
+    
+void MonotonicArena::swap(MonotonicArena& rhs)
+{
+    std::swap(m_base, rhs.m_base);
+    std::swap(m_reserved, rhs.m_reserved);
+    std::swap(m_commitSize, rhs.m_commitSize);
+    std::swap(m_committed, rhs.m_committed);
+    std::swap(m_used, rhs.m_used);
+    std::swap(m_highWater, rhs.m_highWater);
+}
+    
+void* MonotonicArena::malloc(std::size_t size, std::size_t alignment)
+{
+    assert(isValidAlignment(alignment));
+    // the base is only page aligned, a larger alignment depends on where it lies
+    auto offset = static_cast<std::size_t>(pointerDistanceTo(m_base, roundUpPowerOfTwo(m_base + m_used, alignment)));
+    if (offset > m_reserved || size > m_reserved - offset) {
+        return nullptr;
+    }
+    auto end = offset + size;
+    if (end > m_committed && !commit(end)) {
+        return nullptr;
+    }
+    m_used = end;
+    m_highWater = std::max(m_highWater, m_used);
+    return m_base + offset;
+}
+    
+void MonotonicArena::rewindTo(Mark mark)
+{
+    assert(mark <= m_used);
+    m_used = mark;
+}
+    
+void MonotonicArena::reset(std::size_t keepCommitted)
+{
+    m_used = 0;
+    m_highWater = 0;
+    auto keep = keepCommitted < m_committed ? roundUpPowerOfTwo(keepCommitted, vmPageSize()) : m_committed;
+    if (keep < m_committed) {
+        vmDecommit(m_base + keep, m_committed - keep);
+        m_committed = keep;
+    }
+}
+    
+// commit whole steps of m_commitSize up to at least `end'
+bool MonotonicArena::commit(std::size_t end)
+{
+    auto newCommitted = std::min(roundUp(end, m_commitSize), m_reserved);
+    if (!vmCommit(m_base + m_committed, newCommitted - m_committed)) {
+        return false;
+    }
+    m_committed = newCommitted;
+    return true;
+}
+
+} // namespace memory
@@ -0,0 +1,91 @@
+//
+//  monotonic_arena.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef MONOTONIC_ARENA_H
+#define MONOTONIC_ARENA_H
+
+#include <cstddef>
+
+namespace memory
+{
+    
+// Hands out memory by bumping a pointer through a reserved range of address
+// space, committing pages as the pointer reaches them. Nothing is freed on its
+// own: everything allocated after a mark goes away at once by rewinding to the
+// mark, and everything by resetting. Meant for scratch data with a common
+// lifetime, e.g. the temporaries of one request.
+class MonotonicArena
+{
+public:
+    // a position of the bump pointer
+    using Mark = std::size_t;
+    
+    // rewinds the arena to where it was when the scope was entered
+    class Scope
+    {
+    public:
+        explicit Scope(MonotonicArena& arena)
+            : m_arena(arena)
+            , m_mark(arena.mark())
+        {
+        }
+        
+        Scope(const Scope&) = delete;
+        Scope& operator =(const Scope&) = delete;
+        
+        ~Scope()
+        {
+            m_arena.rewindTo(m_mark);
+        }
+    private:
+        MonotonicArena& m_arena;
+        Mark m_mark;
+    };
+    
+    // `reserveSize' bytes of address space are reserved up front, and committed
+    // `commitSize' bytes at a time
+    explicit MonotonicArena(std::size_t reserveSize, std::size_t commitSize = 64 * 1024);
+    ~MonotonicArena();
+    
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator =(const MonotonicArena&) = delete;
+    
+    MonotonicArena(MonotonicArena&& rhs);
+    MonotonicArena& operator =(MonotonicArena&& rhs);
+    
+    void swap(MonotonicArena& rhs);
+    
+    // returns nullptr once the reservation is used up
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    
+    Mark mark() const { return m_used; }
+    // release everything allocated since `mark' was taken
+    void rewindTo(Mark mark);
+    // Release everything. The pages committed beyond the first `keepCommitted'
+    // bytes go back to the OS, e.g. pass the usual peak of a request so a rare
+    // large one doesn't pin its pages forever.
+    void reset(std::size_t keepCommitted = static_cast<std::size_t>(-1));
+    
+    std::size_t used() const { return m_used; }
+    std::size_t committed() const { return m_committed; }
+    // the most bytes in use since the last reset
+    std::size_t highWater() const { return m_highWater; }
+private:
+    bool commit(std::size_t end);
+    
+    char* m_base = nullptr;
+    std::size_t m_reserved = 0;
+    std::size_t m_commitSize = 0;
+    std::size_t m_committed = 0;
+    std::size_t m_used = 0;
+    std::size_t m_highWater = 0;
+};
+
+} // namespace memory
+
+#endif /* MONOTONIC_ARENA_H */
@@ -0,0 +1,270 @@
+//
+//  object_pool.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include "free_list.h"
+#include "list.h"
+#include "memory_utils.h"
+#include "os_memory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace memory
+{
+    
+// Objects of type T carved from slabs mapped from the OS as needed. A slab is
+// aligned to its size, so the slab of an object is found by masking its
+// address. Every slab keeps a bitmap of its live objects, which lets
+// destroyAll() run the destructors without walking any free list.
+template<typename T>
+class ObjectPool
+{
+public:
+    // the objects are laid out back to back, so the block size keeps them aligned
+    static constexpr std::size_t blockAlignment = std::max(alignof(T), alignof(void*));
+    static constexpr std::size_t blockSize =
+        (std::max(sizeof(T), FreeList::minBlockSize) + blockAlignment - 1) / blockAlignment * blockAlignment;
+    
+    // `slabSize' is rounded up to a power of two of at least a page that holds one object
+    explicit ObjectPool(std::size_t slabSize = 64 * 1024)
+    {
+        m_slabSize = std::max(roundUpToPowerOfTwo(slabSize), vmPageSize());
+        while (!capacityFor(m_slabSize)) {
+            m_slabSize *= 2;
+        }
+        m_slabCapacity = capacityFor(m_slabSize);
+    }
+    
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator =(const ObjectPool&) = delete;
+    
+    // the objects still alive are not destroyed, call destroyAll() first if
+    // their destructors have to run
+    ~ObjectPool()
+    {
+        releaseSlabs(m_partialSlabs);
+        releaseSlabs(m_fullSlabs);
+    }
+    
+    // returns nullptr if no slab could be mapped, exceptions of the constructor propagate
+    template<typename... Args>
+    T* create(Args&&... args)
+    {
+        auto slab = m_partialSlabs.first();
+        if (!slab && !(slab = newSlab())) {
+            return nullptr;
+        }
+        if (!slab->live) {
+            --m_numEmptySlabs;
+        }
+        
+        auto p = slab->blocks.malloc();
+        assert(p);
+        T* obj;
+        try {
+            obj = new (p) T(std::forward<Args>(args)...);
+        } catch (...) {
+            slab->blocks.free(p);
+            if (!slab->live) {
+                ++m_numEmptySlabs;
+            }
+            throw;
+        }
+        
+        slab->setLive(slab->indexOf(p), true);
+        ++slab->live;
+        if (slab->blocks.empty()) {
+            m_partialSlabs.remove(*slab);
+            m_fullSlabs.addFirst(*slab);
+        }
+        return obj;
+    }
+    
+    void destroy(T* obj)
+    {
+        if (!obj) {
+            return;
+        }
+        obj->~T();
+        
+        auto slab = slabOf(obj);
+        auto index = slab->indexOf(obj);
+        assert(slab->isLive(index));
+        slab->setLive(index, false);
+        // the next object is created in the slab just freed into, the block is
+        // likely still cached
+        if (slab->blocks.empty()) {
+            m_fullSlabs.remove(*slab);
+            m_partialSlabs.addFirst(*slab);
+        } else if (m_partialSlabs.first() != slab) {
+            m_partialSlabs.remove(*slab);
+            m_partialSlabs.addFirst(*slab);
+        }
+        slab->blocks.free(obj);
+        
+        // keep one empty slab around so a create/destroy pair at the boundary
+        // doesn't map and unmap a slab every time
+        if (!--slab->live && ++m_numEmptySlabs > 1) {
+            --m_numEmptySlabs;
+            m_partialSlabs.remove(*slab);
+            releaseSlab(*slab);
+        }
+    }
+    
+    // destroy every live object, the slabs are kept for reuse
+    void destroyAll()
+    {
+        destroyAll(m_partialSlabs);
+        destroyAll(m_fullSlabs);
+        while (auto slab = m_fullSlabs.first()) {
+            m_fullSlabs.remove(*slab);
+            m_partialSlabs.addLast(*slab);
+        }
+    }
+    
+    std::size_t slabSize() const { return m_slabSize; }
+    // the number of objects a slab holds
+    std::size_t slabCapacity() const { return m_slabCapacity; }
+private:
+    using Word = std::uint64_t;
+    static constexpr std::size_t bitsPerWord = sizeof(Word) * 8;
+    
+    // the header at the start of each slab, followed by the live bitmap and the objects
+    struct Slab : ListNode<Slab>
+    {
+        FreeList blocks;
+        std::size_t live = 0;
+        Word* liveBits = nullptr;
+        char* firstBlock = nullptr;
+        
+        std::size_t indexOf(const void* p) const
+        {
+            auto offset = static_cast<std::size_t>(pointerDistanceTo(firstBlock, p));
+            assert(offset % blockSize == 0);
+            return offset / blockSize;
+        }
+        
+        bool isLive(std::size_t index) const
+        {
+            return liveBits[index / bitsPerWord] >> (index % bitsPerWord) & 1;
+        }
+        
+        void setLive(std::size_t index, bool live)
+        {
+            auto mask = Word(1) << (index % bitsPerWord);
+            if (live) {
+                liveBits[index / bitsPerWord] |= mask;
+            } else {
+                liveBits[index / bitsPerWord] &= ~mask;
+            }
+        }
+    };
+    
+    static std::size_t roundUpToPowerOfTwo(std::size_t n)
+    {
+        std::size_t p = 1;
+        while (p < n) {
+            p *= 2;
+        }
+        return p;
+    }
+    
+    static std::size_t bitmapOffset()
+    {
+        return roundUpPowerOfTwo(sizeof(Slab), alignof(Word));
+    }
+    
+    static std::size_t blocksOffset(std::size_t capacity)
+    {
+        auto words = (capacity + bitsPerWord - 1) / bitsPerWord;
+        return roundUpPowerOfTwo(bitmapOffset() + words * sizeof(Word), alignof(T));
+    }
+    
+    static std::size_t capacityFor(std::size_t slabSize)
+    {
+        // each object costs its block plus one bit of the bitmap
+        auto capacity = (slabSize - bitmapOffset()) * 8 / (blockSize * 8 + 1);
+        while (capacity && blocksOffset(capacity) + capacity * blockSize > slabSize) {
+            --capacity;
+        }
+        return capacity;
+    }
+    
+    Slab* slabOf(const void* p) const
+    {
+        return alignedCast<Slab*>(roundDownPowerOfTwo(const_cast<void*>(p), m_slabSize));
+    }
+    
+    Slab* newSlab()
+    {
+        auto p = static_cast<char*>(vmAllocateAligned(m_slabSize, m_slabSize));
+        if (!p) {
+            return nullptr;
+        }
+        // fresh pages are zero filled, so is the bitmap
+        auto slab = new (p) Slab;
+        slab->liveBits = alignedCast<Word*>(p + bitmapOffset());
+        slab->firstBlock = p + blocksOffset(m_slabCapacity);
+        slab->blocks = FreeList(slab->firstBlock, slab->firstBlock + m_slabCapacity * blockSize, blockSize, true);
+        m_partialSlabs.addFirst(*slab);
+        ++m_numEmptySlabs;
+        return slab;
+    }
+    
+    void releaseSlab(Slab& slab)
+    {
+        slab.~Slab();
+        vmDeallocate(&slab, m_slabSize);
+    }
+    
+    void releaseSlabs(List<Slab>& slabs)
+    {
+        while (auto slab = slabs.first()) {
+            slabs.remove(*slab);
+            releaseSlab(*slab);
+        }
+    }
+    
+    void destroyAll(List<Slab>& slabs)
+    {
+        auto numWords = (m_slabCapacity + bitsPerWord - 1) / bitsPerWord;
+        for (auto slab = slabs.first(); slab; slab = slab->next()) {
+            if (!slab->live) {
+                continue;
+            }
+            for (std::size_t i = 0; i < numWords; ++i) {
+                for (auto live = slab->liveBits[i]; live; live &= live - 1) {
+                    auto index = i * bitsPerWord + countTrailingZeros(live);
+                    reinterpret_cast<T*>(slab->firstBlock + index * blockSize)->~T();
+                }
+                slab->liveBits[i] = 0;
+            }
+            // start over with an empty list instead of freeing every block
+            slab->blocks = FreeList(slab->firstBlock, slab->firstBlock + m_slabCapacity * blockSize, blockSize);
+            slab->live = 0;
+            ++m_numEmptySlabs;
+        }
+    }
+    
+    // slabs with a free block, and the ones without
+    List<Slab> m_partialSlabs;
+    List<Slab> m_fullSlabs;
+    std::size_t m_numEmptySlabs = 0;
+    std::size_t m_slabSize = 0;
+    std::size_t m_slabCapacity = 0;
+};
+
+} // namespace memory
+
+#endif /* OBJECT_POOL_H */
@@ -7,17 +7,22 @@
 //
 
 #include "os_memory.h"
+#include "trace_path.h"
 #include <cassert>
+#include <cstring>
+#include <cstdint>
 
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
 #  include <sys/mman.h>
 #  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
 #endif
 
 namespace memory
 {
     
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
 
 std::size_t vmPageSize()
 {
@@ -28,16 +33,179 @@ std::size_t vmPageSize()
 void* vmAllocate(std::size_t sizeBytes)
 {
     assert(sizeBytes);
+    MEMORY_TRACE_PATH(osMap);
     void* p = mmap(nullptr, sizeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     return p != MAP_FAILED ? p : nullptr;
 }
     
+void* vmAllocatePopulated(std::size_t sizeBytes)
+{
+    assert(sizeBytes);
+    MEMORY_TRACE_PATH(osMap);
+#ifdef __linux__
+    void* p = mmap(nullptr, sizeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    return p != MAP_FAILED ? p : nullptr;
+#else
+    auto p = static_cast<volatile char*>(vmAllocate(sizeBytes));
+    if (p) {
+        // a write, a read would only map the shared zero page
+        for (std::size_t i = 0; i < sizeBytes; i += vmPageSize()) {
+            p[i] = 0;
+        }
+    }
+    return const_cast<char*>(p);
+#endif
+}
+    
 void vmDeallocate(void* p, std::size_t sizeBytes)
 {
     assert(sizeBytes);
+    MEMORY_TRACE_PATH(osUnmap);
     auto res = munmap(p, sizeBytes);
     assert(!res);
 }
+    
+void* vmAllocateAligned(std::size_t sizeBytes, std::size_t alignment)
+{
+    assert(sizeBytes && alignment >= vmPageSize() && !(alignment & (alignment - 1)));
+    // map enough to contain an aligned range and unmap the rest around it
+    auto mappedSize = sizeBytes + alignment - vmPageSize();
+    auto p = static_cast<char*>(vmAllocate(mappedSize));
+    if (!p) {
+        return nullptr;
+    }
+    auto aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(p) + alignment - 1) & ~(alignment - 1));
+    if (aligned != p) {
+        vmDeallocate(p, aligned - p);
+    }
+    if (auto tail = p + mappedSize - (aligned + sizeBytes)) {
+        vmDeallocate(aligned + sizeBytes, tail);
+    }
+    return aligned;
+}
+    
+void* vmReallocate(void* p, std::size_t oldSizeBytes, std::size_t newSizeBytes)
+{
+    assert(p && oldSizeBytes && newSizeBytes);
+#ifdef __linux__
+    // let the kernel move the page table entries instead of copying the pages
+    void* newp = mremap(p, oldSizeBytes, newSizeBytes, MREMAP_MAYMOVE);
+    return newp != MAP_FAILED ? newp : nullptr;
+#else
+    if (newSizeBytes <= oldSizeBytes) {
+        if (newSizeBytes < oldSizeBytes) {
+            vmDeallocate(static_cast<char*>(p) + newSizeBytes, oldSizeBytes - newSizeBytes);
+        }
+        return p;
+    }
+    void* newp = vmAllocate(newSizeBytes);
+    if (newp) {
+        std::memcpy(newp, p, oldSizeBytes);
+        vmDeallocate(p, oldSizeBytes);
+    }
+    return newp;
+#endif
+}
+    
+void vmPurge(void* p, std::size_t sizeBytes)
+{
+    assert(sizeBytes);
+#ifdef __linux__
+    auto res = madvise(p, sizeBytes, MADV_DONTNEED);
+    assert(!res);
+#else
+    // MADV_FREE doesn't guarantee zeros, map fresh pages over the range instead
+    auto res = mmap(p, sizeBytes, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(res != MAP_FAILED);
+#endif
+    (void)res;
+}
+    
+void* vmReserve(std::size_t sizeBytes)
+{
+    assert(sizeBytes);
+    void* p = mmap(nullptr, sizeBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p != MAP_FAILED ? p : nullptr;
+}
+    
+bool vmCommit(void* p, std::size_t sizeBytes)
+{
+    assert(sizeBytes);
+    return mprotect(p, sizeBytes, PROT_READ | PROT_WRITE) == 0;
+}
+    
+void vmDecommit(void* p, std::size_t sizeBytes)
+{
+    assert(sizeBytes);
+#ifdef __linux__
+    auto res = madvise(p, sizeBytes, MADV_DONTNEED);
+    assert(!res);
+    res = mprotect(p, sizeBytes, PROT_NONE);
+    assert(!res);
+#else
+    auto res = mmap(p, sizeBytes, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(res != MAP_FAILED);
+#endif
+    (void)res;
+}
+    
+int vmCreatePageFile()
+{
+#ifdef __linux__
+    return memfd_create("memory_pages", MFD_CLOEXEC);
+#else
+    return -1;
+#endif
+}
+    
+void vmClosePageFile(int file)
+{
+    assert(file >= 0);
+    close(file);
+}
+    
+bool vmResizePageFile(int file, std::size_t sizeBytes)
+{
+    assert(file >= 0);
+    return ftruncate(file, sizeBytes) == 0;
+}
+    
+void* vmMapPageFile(int file, std::size_t offset, std::size_t sizeBytes, void* address)
+{
+    assert(file >= 0 && sizeBytes);
+    int flags = MAP_SHARED | (address ? MAP_FIXED : 0);
+    void* p = mmap(address, sizeBytes, PROT_READ | PROT_WRITE, flags, file, offset);
+    return p != MAP_FAILED ? p : nullptr;
+}
+    
+void vmPunchPageFile(int file, std::size_t offset, std::size_t sizeBytes)
+{
+    assert(file >= 0 && sizeBytes);
+#ifdef __linux__
+    auto res = fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, sizeBytes);
+    assert(!res);
+    (void)res;
+#endif
+}
+    
+int vmOpenPageFile(const char* path)
+{
+    assert(path);
+    return open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+    
+std::size_t vmPageFileSize(int file)
+{
+    assert(file >= 0);
+    struct stat st;
+    return fstat(file, &st) == 0 ? st.st_size : 0;
+}
+    
+bool vmSync(void* p, std::size_t sizeBytes)
+{
+    assert(reinterpret_cast<std::uintptr_t>(p) % vmPageSize() == 0);
+    return msync(p, sizeBytes, MS_SYNC) == 0;
+}
 
 #endif
     
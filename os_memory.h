@@ -17,6 +17,40 @@ namespace memory
 std::size_t vmPageSize();
 void* vmAllocate(std::size_t sizeBytes);
 void vmDeallocate(void* p, std::size_t sizeBytes);
+// like vmAllocate, with the pages faulted in up front so the first touch doesn't trap
+void* vmAllocatePopulated(std::size_t sizeBytes);
+// like vmAllocate, with the mapping aligned to `alignment', a power of two multiple of the page size
+void* vmAllocateAligned(std::size_t sizeBytes, std::size_t alignment);
+// resize a mapping returned by vmAllocate, the mapping may move
+void* vmReallocate(void* p, std::size_t oldSizeBytes, std::size_t newSizeBytes);
+// release the physical pages of a private anonymous range, it reads as zeros afterwards
+void vmPurge(void* p, std::size_t sizeBytes);
+
+// reserve address space without backing it, [p, p + sizeBytes) faults until committed,
+// it is released with vmDeallocate
+void* vmReserve(std::size_t sizeBytes);
+// make a page aligned range of a reservation usable, it reads as zeros
+bool vmCommit(void* p, std::size_t sizeBytes);
+// give the physical pages of a committed range back and make it inaccessible again
+void vmDecommit(void* p, std::size_t sizeBytes);
+
+// An anonymous file whose pages can be mapped at several addresses at once,
+// -1 is returned where it isn't supported
+int vmCreatePageFile();
+void vmClosePageFile(int file);
+bool vmResizePageFile(int file, std::size_t sizeBytes);
+// map [offset, offset + sizeBytes) of the file shared, replacing whatever is mapped
+// at `address' if it is given
+void* vmMapPageFile(int file, std::size_t offset, std::size_t sizeBytes, void* address = nullptr);
+// give the physical pages of the file range back, it reads as zeros afterwards
+void vmPunchPageFile(int file, std::size_t offset, std::size_t sizeBytes);
+// open the file at `path' to map it like a page file, creating an empty one if
+// there is none, -1 is returned on failure
+int vmOpenPageFile(const char* path);
+std::size_t vmPageFileSize(int file);
+// write the pages of a shared file mapping back to the file and wait for it,
+// `p' has to be page aligned
+bool vmSync(void* p, std::size_t sizeBytes);
     
 } // namespace memory
 
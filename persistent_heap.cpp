@@ -0,0 +1,212 @@
+//
+//  persistent_heap.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "persistent_heap.h"
+#include "os_memory.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace memory
+{
+
+// the offset marks a root taken, the name is written first
+struct PersistentHeap::Root
+{
+    char name[maxRootName + 1];
+    std::uint64_t offset;
+};
+
+// lies at the start of the file, the heap follows it
+struct PersistentHeap::Header
+{
+    // set last, once the heap is laid out
+    std::uint64_t magic;
+    std::uint32_t version;
+    // cleared while the heap is open
+    std::uint32_t clean;
+    std::uint64_t size;
+    Root roots[maxRoots];
+
+    char* heap() { return reinterpret_cast<char*>(this + 1); }
+    char* end() { return reinterpret_cast<char*>(this) + size; }
+};
+
+namespace
+{
+
+constexpr std::uint64_t heapMagic = 0x7065727368656170;
+// bumped whenever the layout of the header or the blocks changes
+constexpr std::uint32_t heapVersion = 1;
+
+} // namespace
+
+PersistentHeap PersistentHeap::open(const char* path, std::size_t size)
+{
+    PersistentHeap heap;
+    auto file = vmOpenPageFile(path);
+    if (file < 0) {
+        return heap;
+    }
+
+    auto fileSize = vmPageFileSize(file);
+    bool created = !fileSize;
+    if (created) {
+        fileSize = size;
+    }
+    // the links of the blocks can't span a larger heap
+    if (fileSize < sizeof(Header) || fileSize - sizeof(Header) > CompressedLinks::maxDistance ||
+        (created && !vmResizePageFile(file, fileSize))) {
+        vmClosePageFile(file);
+        return heap;
+    }
+    auto header = static_cast<Header*>(vmMapPageFile(file, 0, fileSize));
+    if (!header) {
+        vmClosePageFile(file);
+        return heap;
+    }
+
+    CompressedLargeAllocator allocator;
+    bool recovered = false;
+    if (created) {
+        // the file was extended with zeros
+        new (header) Header{};
+        header->version = heapVersion;
+        header->size = fileSize;
+        allocator = CompressedLargeAllocator(header->heap(), header->end(), 0, true);
+        header->magic = heapMagic;
+    } else if (fileSize >= sizeof(Header) && header->magic == heapMagic && header->version == heapVersion &&
+               header->size == fileSize) {
+        allocator = CompressedLargeAllocator::attach(header->heap(), header->end());
+        recovered = !header->clean;
+    } else {
+        vmDeallocate(header, fileSize);
+        vmClosePageFile(file);
+        return heap;
+    }
+    if (recovered && !allocator.recover()) {
+        vmDeallocate(header, fileSize);
+        vmClosePageFile(file);
+        return heap;
+    }
+
+    // a crash from now on is told by the flag
+    header->clean = false;
+    vmSync(header, sizeof(Header));
+
+    heap.m_file = file;
+    heap.m_header = header;
+    heap.m_allocator = std::move(allocator);
+    heap.m_recovered = recovered;
+    return heap;
+}
+
+PersistentHeap::PersistentHeap(PersistentHeap&& rhs)
+{
+    swap(rhs);
+}
+
+PersistentHeap& PersistentHeap::operator =(PersistentHeap&& rhs)
+{
+    swap(rhs);
+    return *this;
+}
+
+void PersistentHeap::swap(PersistentHeap& rhs)
+{
+    std::swap(m_file, rhs.m_file);
+    std::swap(m_header, rhs.m_header);
+    m_allocator.swap(rhs.m_allocator);
+    std::swap(m_recovered, rhs.m_recovered);
+}
+
+void PersistentHeap::close()
+{
+    if (!m_header) {
+        return;
+    }
+    // the flag may only reach the file after everything else did, a heap which
+    // didn't make it there is recovered the next time
+    if (checkpoint()) {
+        m_header->clean = true;
+        vmSync(m_header, sizeof(Header));
+    }
+
+    vmDeallocate(m_header, m_header->size);
+    vmClosePageFile(m_file);
+    m_file = -1;
+    m_header = nullptr;
+    m_allocator = CompressedLargeAllocator();
+    m_recovered = false;
+}
+
+bool PersistentHeap::checkpoint()
+{
+    assert(valid());
+    return vmSync(m_header, m_header->size);
+}
+
+void* PersistentHeap::malloc(std::size_t size, std::size_t alignment)
+{
+    assert(valid());
+    return m_allocator.malloc(size, alignment);
+}
+
+void* PersistentHeap::calloc(std::size_t count, std::size_t size, std::size_t alignment)
+{
+    assert(valid());
+    return m_allocator.calloc(count, size, alignment);
+}
+
+void PersistentHeap::free(void* p)
+{
+    if (p) {
+        assert(valid() && owns(p));
+        m_allocator.free(p);
+    }
+}
+
+bool PersistentHeap::setRoot(const char* name, void* p)
+{
+    assert(valid() && name && std::strlen(name) <= maxRootName);
+    assert(!p || owns(p));
+    Root* unused = nullptr;
+    for (auto& root : m_header->roots) {
+        if (!root.offset) {
+            unused = unused ? unused : &root;
+        } else if (!std::strcmp(root.name, name)) {
+            root.offset = p ? static_cast<char*>(p) - reinterpret_cast<char*>(m_header) : 0;
+            return true;
+        }
+    }
+    if (!p) {
+        return true;
+    }
+    if (!unused) {
+        return false;
+    }
+    std::strcpy(unused->name, name);
+    unused->offset = static_cast<char*>(p) - reinterpret_cast<char*>(m_header);
+    return true;
+}
+
+void* PersistentHeap::root(const char* name) const
+{
+    assert(valid() && name);
+    for (auto& root : m_header->roots) {
+        if (root.offset && !std::strcmp(root.name, name)) {
+            return reinterpret_cast<char*>(m_header) + root.offset;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace memory
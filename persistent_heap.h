@@ -0,0 +1,89 @@
+//
+//  persistent_heap.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef PERSISTENT_HEAP_H
+#define PERSISTENT_HEAP_H
+
+#include "large_allocator.h"
+
+#include <cstddef>
+
+namespace memory
+{
+
+// A heap in a file mapped shared, which outlives the process: opening the file
+// again maps the same blocks back, wherever they land, since everything the
+// heap keeps links by offsets. Named roots find the blocks the data starts
+// from after a restart. Heaps of up to 4 GiB, not safe to use from several
+// threads at once.
+//
+// The file records whether the heap was closed, and one that wasn't is
+// checked by walking its blocks and has its free block index rebuilt. Only
+// the heap itself is recovered, what was stored in the blocks is as up to
+// date as the last checkpoint() if the machine went down, or the last write
+// if only the process did.
+//
+//     auto heap = memory::PersistentHeap::open("index.heap", size);
+//     auto index = static_cast<Index*>(heap.root("index"));
+//     if (!index) {
+//         index = new (heap.malloc(sizeof(Index))) Index;
+//         heap.setRoot("index", index);
+//     }
+class PersistentHeap
+{
+public:
+    static constexpr std::size_t maxRoots = 64;
+    static constexpr std::size_t maxRootName = 31;
+
+    // Maps the heap in the file at `path', or lays a new one of `size' bytes
+    // out if the file is empty or missing. The heap isn't valid() if the file
+    // holds something else, a heap damaged beyond recovery, or the size is
+    // beyond the 4 GiB the heap can span.
+    static PersistentHeap open(const char* path, std::size_t size);
+    ~PersistentHeap() { close(); }
+
+    PersistentHeap(PersistentHeap&& rhs);
+    PersistentHeap& operator =(PersistentHeap&& rhs);
+
+    bool valid() const { return m_header; }
+    // whether the heap wasn't closed the last time and had to be recovered
+    bool recovered() const { return m_recovered; }
+
+    // writes the heap back to the file and marks it closed if that succeeded
+    void close();
+    // writes the heap back to the file and waits for it, false if that fails
+    bool checkpoint();
+
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void* calloc(std::size_t count, std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void free(void* p);
+
+    std::size_t usableSize(const void* p) const { return m_allocator.usableSize(p); }
+    bool owns(const void* p) const { return m_allocator.owns(p); }
+
+    // Names `p', a pointer into the heap, or forgets the name for null.
+    // Returns false if all the roots are taken.
+    bool setRoot(const char* name, void* p);
+    // where the root named `name' points in this mapping, null if there is none
+    void* root(const char* name) const;
+private:
+    struct Root;
+    struct Header;
+
+    PersistentHeap() = default;
+    void swap(PersistentHeap& rhs);
+
+    int m_file = -1;
+    Header* m_header = nullptr;
+    CompressedLargeAllocator m_allocator;
+    bool m_recovered = false;
+};
+
+} // namespace memory
+
+#endif /* PERSISTENT_HEAP_H */
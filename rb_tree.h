@@ -9,23 +9,33 @@
 #ifndef RB_TREE_H
 #define RB_TREE_H
 
+#include "intrusive_links.h"
+
 #include <type_traits>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <iterator>
 #include <algorithm>
+#include <cassert>
+#include <utility>
 
 #pragma once
 
 template<typename Tree, typename Key, typename Comp>
 class RbTreeIterator;
 
-template<typename Key, typename Comp>
+template<typename Key, typename Comp, typename Augment>
 class RbTree;
 
-class RbTreeNode
+// The links of the nodes are PointerLinks by default, deriving Key from
+// BasicRbTreeNode<CompressedLinks> instead halves their size, but the nodes
+// and the tree itself have to lie within reach of each other, e.g. in the
+// same arena.
+template<typename Links>
+class BasicRbTreeNode
 {
-    template<typename Key, typename Comp>
+    template<typename Key, typename Comp, typename Augment>
     friend class RbTree;
     
     template<typename Tree, typename Key, typename Comp>
@@ -36,19 +46,16 @@ class RbTreeNode
         black,
         mask = 0x1
     };
+public:
+    using RbTreeLinks = Links;
 protected:
-    RbTreeNode() = default;
+    BasicRbTreeNode() = default;
 private:
-    RbTreeNode* parent() const
-    {
-        return reinterpret_cast<RbTreeNode*>(
-                    reinterpret_cast<std::uintptr_t>(m_parent) & ~Color::mask);
-    }
+    BasicRbTreeNode* parent() const { return m_parent.get(); }
+    BasicRbTreeNode* left() const { return m_left.get(); }
+    BasicRbTreeNode* right() const { return m_right.get(); }
     
-    RbTreeNode* left() const { return m_left; }
-    RbTreeNode* right() const { return m_right; }
-    
-    RbTreeNode* minimum()
+    BasicRbTreeNode* minimum()
     {
         auto node = this;
         while (node->left()) {
@@ -57,7 +64,7 @@ private:
         return node;
     }
     
-    RbTreeNode* maximum()
+    BasicRbTreeNode* maximum()
     {
         auto node = this;
         while (node->right()) {
@@ -66,7 +73,7 @@ private:
         return node;
     }
     
-    RbTreeNode* successor()
+    BasicRbTreeNode* successor()
     {
         if (right()) {
             return right()->minimum();
@@ -82,7 +89,7 @@ private:
         return cur->right() != parent ? parent : cur;
     }
     
-    RbTreeNode* predecessor()
+    BasicRbTreeNode* predecessor()
     {
         if (left()) {
             return left()->maximum();
@@ -98,43 +105,94 @@ private:
         return cur->left() != parent ? parent : cur;
     }
     
-    void setLeft(RbTreeNode* left) { m_left = left; }
-    void setRight(RbTreeNode* right) { m_right = right; }
+    void setLeft(BasicRbTreeNode* left) { m_left.set(left); }
+    void setRight(BasicRbTreeNode* right) { m_right.set(right); }
     
-    void setParent(RbTreeNode* parent)
+    void setParent(BasicRbTreeNode* parent)
     {
         assert(parent != this);
-        m_parent = reinterpret_cast<RbTreeNode*>(
-                        reinterpret_cast<std::uintptr_t>(parent) | color());
+        m_parent.set(parent);
     }
     
     void reset()
     {
-        m_parent = m_left = m_right = nullptr;
+        m_parent = {};
+        m_left = {};
+        m_right = {};
     }
     
     Color color() const
     {
-        return static_cast<Color>(
-                    reinterpret_cast<std::uintptr_t>(m_parent) & Color::mask);
+        return static_cast<Color>(m_parent.tag());
     }
     
     void setColor(Color color)
     {
         assert(color <= Color::black);
-        m_parent = reinterpret_cast<RbTreeNode*>(
-                     reinterpret_cast<std::uintptr_t>(parent()) | color);
+        m_parent.setTag(color);
     }
     
-    RbTreeNode* m_parent = nullptr;
-    RbTreeNode* m_left = nullptr;
-    RbTreeNode* m_right = nullptr;
+    // the color is kept in the link to the parent
+    typename Links::template TaggedLink<BasicRbTreeNode> m_parent;
+    typename Links::template Link<BasicRbTreeNode> m_left;
+    typename Links::template Link<BasicRbTreeNode> m_right;
+};
+
+using RbTreeNode = BasicRbTreeNode<PointerLinks>;
+
+// Deriving Key from RbTreeChainNode instead of RbTreeNode makes the tree keep
+// one node per distinct key. Equal keys are chained in a ring to the one in
+// the tree, so inserting or removing a duplicate doesn't touch the tree, and
+// the tree only grows with the number of distinct keys. Duplicates come first
+// when iterating, the most recently inserted one first.
+template<typename Links>
+class BasicRbTreeChainNode : public BasicRbTreeNode<Links>
+{
+    template<typename Key, typename Comp, typename Augment>
+    friend class RbTree;
+protected:
+    BasicRbTreeChainNode() = default;
+private:
+    BasicRbTreeChainNode* chainPrev() const { return m_chainPrev.get(); }
+    BasicRbTreeChainNode* chainNext() const { return m_chainNext.get(); }
+    void setChainPrev(BasicRbTreeChainNode* node) { m_chainPrev.set(node); }
+    void setChainNext(BasicRbTreeChainNode* node) { m_chainNext.set(node); }
+    
+    typename Links::template Link<BasicRbTreeChainNode> m_chainPrev;
+    typename Links::template Link<BasicRbTreeChainNode> m_chainNext;
 };
 
-template<typename Key, typename Comp = std::less<Key>>
-class RbTree : protected Comp
+using RbTreeChainNode = BasicRbTreeChainNode<PointerLinks>;
+
+// the default Augment of RbTree, which keeps nothing about subtrees
+struct RbTreeNoAugment
 {
-    static_assert(std::is_base_of_v<RbTreeNode, Key>, "Key must derive from RbTreeNode");
+    template<typename Key>
+    void operator()(Key&, const Key*, const Key*) const {}
+};
+
+// where RbTree::descend goes from a node
+enum class RbTreeDirection {
+    left,
+    right,
+    here,
+    none
+};
+
+// An Augment keeps data about the subtree of every node in the node, e.g. the
+// largest value below it. It is called as augment(node, left, right), with
+// null for missing children, to recompute the data of `node' from its own and
+// that of its children, whenever the subtree of `node' changes shape.
+template<typename Key, typename Comp = std::less<Key>, typename Augment = RbTreeNoAugment>
+class RbTree : protected Comp, protected Augment
+{
+    using Links = typename Key::RbTreeLinks;
+    using Node = BasicRbTreeNode<Links>;
+    using ChainNode = BasicRbTreeChainNode<Links>;
+    
+    static_assert(std::is_base_of_v<Node, Key>, "Key must derive from RbTreeNode");
+    static constexpr bool chained = std::is_base_of_v<ChainNode, Key>;
+    static constexpr bool augmented = !std::is_same_v<Augment, RbTreeNoAugment>;
 public:
     template<typename T, typename U, typename V>
     friend class RbTreeIterator;
@@ -144,16 +202,18 @@ public:
     using reverse_iterator = std::reverse_iterator<iterator>;
     using reverse_const_iterator = std::reverse_iterator<const_iterator>;
 
-    RbTree(const Comp& comp = Comp())
+    RbTree(const Comp& comp = Comp(), const Augment& augment = Augment())
         : Comp(comp)
+        , Augment(augment)
     {
-        m_sentinel.setColor(RbTreeNode::black);
+        m_sentinel.setColor(Node::black);
         m_sentinel.setLeft(&m_sentinel);
         m_sentinel.setRight(&m_sentinel);
     }
     
     RbTree(const RbTree&) = delete;
     RbTree(RbTree&& rhs)
+        : RbTree(static_cast<const Comp&>(rhs), static_cast<const Augment&>(rhs))
     {
         swap(rhs);
     }
@@ -167,18 +227,17 @@ public:
     
     void swap(RbTree& rhs)
     {
-        std::swap(m_sentinel, rhs.m_sentinel);
-        // fix up the parents of the root nodes
-        if (root()) {
-            root()->setParent(&rhs.m_sentinel);
-        }
-        if (rhs.root()) {
-            rhs.root()->setParent(&m_sentinel);
-        }
+        // the links of the sentinels may be relative to where they are, so
+        // relink them rather than swapping them
+        auto nodes = rhs.root();
+        auto first = rhs.leftmost();
+        auto last = rhs.rightmost();
+        rhs.adopt(root(), leftmost(), rightmost());
+        adopt(nodes, first, last);
     }
     
-    iterator begin() { return { *this, *leftmost() }; }
-    const_iterator begin() const { return { const_cast<RbTree&>(*this), *leftmost() }; }
+    iterator begin() { return { *this, *firstOf(leftmost()) }; }
+    const_iterator begin() const { return { const_cast<RbTree&>(*this), *firstOf(leftmost()) }; }
     
     reverse_iterator rbegin() { return end(); }
     reverse_const_iterator rbegin() const { return end(); }
@@ -197,6 +256,11 @@ public:
 
     bool empty() const { return leftmost() == &m_sentinel; }
     
+    // Forgets all the nodes without touching them, e.g. when they can't be
+    // trusted any more. They have to be rebuilt with buildFromSorted() to be
+    // put in a tree again.
+    void clear() { adopt(nullptr, nullptr, nullptr); }
+    
     void insert(Key& node)
     {
         assert(!node.parent());
@@ -211,9 +275,19 @@ public:
             if (smaller) {
                 cur = cur->left();
             } else {
+                if constexpr (chained) {
+                    if (!compare(static_cast<const Key&>(*cur), node)) {
+                        addDuplicate(node, *chainNode(cur));
+                        return;
+                    }
+                }
                 cur = cur->right();
             }
         }
+        if constexpr (chained) {
+            node.setChainPrev(&node);
+            node.setChainNext(&node);
+        }
         if (parent == &m_sentinel) {
             setRoot(&node);
             setLeftMost(&node);
@@ -231,7 +305,9 @@ public:
             }
         }
         node.setParent(parent);
-        node.setColor(RbTreeNode::red);
+        node.setColor(Node::red);
+        // rotations keep the data of the subtree they turn, fix the path first
+        augmentUp(&node);
 
         insertFixup(&node);
         assert(node.parent());
@@ -240,16 +316,34 @@ public:
     
     void remove(const Key& node)
     {
+        if constexpr (chained) {
+            auto& chainedNode = const_cast<Key&>(node);
+            if (!node.parent()) {
+                unlink(chainedNode);
+                return;
+            }
+            // the oldest duplicate takes over the place in the tree
+            if (node.chainPrev() != &node) {
+                auto duplicate = node.chainPrev();
+                unlink(chainedNode);
+                replace(chainedNode, *duplicate);
+                augmentUp(duplicate);
+                validate();
+                return;
+            }
+            chainedNode.setChainPrev(nullptr);
+            chainedNode.setChainNext(nullptr);
+        }
         assert(node.parent());
         
         // the node to delete or to replace `node'
-        RbTreeNode* candidate;
+        Node* candidate;
         if (!node.left() || !node.right()) {
             candidate = const_cast<Key*>(&node);
         } else {
             candidate = const_cast<Key&>(node).successor();
         }
-        RbTreeNode* child;
+        Node* child;
         if (candidate->left()) {
             child = candidate->left();
         } else {
@@ -304,31 +398,402 @@ public:
                 }
             }
         }
-        if (candidateColor == RbTreeNode::black) {
+        augmentUp(childParent);
+        if (candidateColor == Node::black) {
             removeFixup(child, childParent);
         }
         const_cast<Key&>(node).reset();
         validate();
     }
     
-    const_iterator lowerBound(const Key& key) const
+    // recompute the subtree data on the path from `node' to the root, after
+    // changing what the Augment reads from `node' in place
+    void updated(Key& node)
+    {
+        assert(node.parent());
+        augmentUp(&node);
+    }
+    
+    // Walks down from the root asking visit(node, left, right) where to go
+    // next, with null for missing children. Ends at the node the visitor
+    // answers `here' for, or at end() if it answers `none' or runs out of nodes.
+    template<typename Visitor>
+    const_iterator descend(Visitor&& visit) const
     {
-        const RbTreeNode* res = nullptr;
         auto cur = root();
+        while (cur) {
+            switch (visit(static_cast<const Key&>(*cur), keyOf(cur->left()), keyOf(cur->right()))) {
+            case RbTreeDirection::left:
+                cur = cur->left();
+                break;
+            case RbTreeDirection::right:
+                cur = cur->right();
+                break;
+            case RbTreeDirection::here:
+                return { *this, *cur };
+            case RbTreeDirection::none:
+                return end();
+            }
+        }
+        return end();
+    }
+    
+    // The lookups take anything the comparator compares with a Key when it
+    // defines `is_transparent', like the ordered std containers do, so a
+    // search doesn't need a Key built to look for.
+    const_iterator lowerBound(const Key& key) const { return lowerBoundOf(key); }
+    
+    template<typename K, typename C = Comp, typename = typename C::is_transparent>
+    const_iterator lowerBound(const K& key) const { return lowerBoundOf(key); }
+    
+    const_iterator upperBound(const Key& key) const { return upperBoundOf(key); }
+    
+    template<typename K, typename C = Comp, typename = typename C::is_transparent>
+    const_iterator upperBound(const K& key) const { return upperBoundOf(key); }
+    
+    std::pair<const_iterator, const_iterator> equalRange(const Key& key) const
+    {
+        return { lowerBoundOf(key), upperBoundOf(key) };
+    }
+    
+    template<typename K, typename C = Comp, typename = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator> equalRange(const K& key) const
+    {
+        return { lowerBoundOf(key), upperBoundOf(key) };
+    }
+    
+    const_iterator find(const Key& key) const { return findOf(key); }
+    
+    template<typename K, typename C = Comp, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const { return findOf(key); }
+    
+    // Like lowerBound(key), but climbs from `hint' only as far as the subtree
+    // holding the result instead of walking down from the root, so the cost
+    // grows with the distance between the two rather than the size of the
+    // tree. Meant for lookups close to the previous result.
+    const_iterator lowerBound(const Key& key, const_iterator hint) const { return lowerBoundOf(key, hint); }
+    
+    template<typename K, typename C = Comp, typename = typename C::is_transparent>
+    const_iterator lowerBound(const K& key, const_iterator hint) const { return lowerBoundOf(key, hint); }
+    
+    // Builds the tree in linear time from the keys `first' to `last' refer or
+    // point to, which have to be in order. The tree has to be empty, the links
+    // the keys hold are overwritten.
+    template<typename It>
+    void buildFromSorted(It first, It last)
+    {
+        assert(empty());
+        std::size_t count = 0;
+        const Key* prev = nullptr;
+        for (auto it = first; it != last; ++it) {
+            const Key& key = keyAt(it);
+            assert(!prev || !compare(key, *prev));
+            if (!chained || !prev || compare(*prev, key)) {
+                ++count;
+            }
+            prev = &key;
+        }
+        RangeSource<It> source{ first, last };
+        build(source, count);
+    }
+    
+    // Moves all the nodes of `rhs' into this tree, in time linear in the size
+    // of both.
+    void join(RbTree& rhs)
+    {
+        auto lhsList = flatten();
+        auto rhsList = rhs.flatten();
+        Node* head = nullptr;
+        Node* tail = nullptr;
+        // the nodes of this tree go first among equal keys
+        while (lhsList && rhsList) {
+            auto& from = compare(*keyOf(rhsList), *keyOf(lhsList)) ? rhsList : lhsList;
+            if (tail) {
+                tail->setLeft(from);
+            } else {
+                head = from;
+            }
+            tail = from;
+            from = from->left();
+        }
+        auto rest = lhsList ? lhsList : rhsList;
+        if (tail) {
+            tail->setLeft(rest);
+        } else {
+            head = rest;
+        }
+        ListSource source{ head };
+        build(source, countKeys(head));
+    }
+    
+    // Moves the nodes not less than `key' into `greater', which has to be
+    // empty, in linear time.
+    void split(const Key& key, RbTree& greater)
+    {
+        assert(greater.empty());
+        auto head = flatten();
+        auto rhsList = head;
+        for (Node* prev = nullptr; rhsList; prev = rhsList, rhsList = rhsList->left()) {
+            if (!compare(*keyOf(rhsList), key)) {
+                if (prev) {
+                    prev->setLeft(nullptr);
+                } else {
+                    head = nullptr;
+                }
+                break;
+            }
+        }
+        ListSource source{ head };
+        build(source, countKeys(head));
+        ListSource rhsSource{ rhsList };
+        greater.build(rhsSource, greater.countKeys(rhsList));
+    }
+private:
+    // where build() takes the nodes from, in order
+    template<typename It>
+    struct RangeSource
+    {
+        It it;
+        It last;
+        
+        Key* peek() const { return it != last ? &keyAt(it) : nullptr; }
+        
+        Key* take()
+        {
+            auto key = &keyAt(it);
+            ++it;
+            return key;
+        }
+    };
+    
+    template<typename It>
+    static Key& keyAt(const It& it)
+    {
+        if constexpr (std::is_pointer_v<std::decay_t<decltype(*it)>>) {
+            return static_cast<Key&>(**it);
+        } else {
+            return static_cast<Key&>(*it);
+        }
+    }
+    
+    // nodes linked through their left links by flatten()
+    struct ListSource
+    {
+        Node* head;
+        
+        Key* peek() const { return static_cast<Key*>(head); }
+        
+        Key* take()
+        {
+            auto key = static_cast<Key*>(head);
+            head = head->left();
+            return key;
+        }
+    };
+    
+    // Empties the tree and returns its nodes in order, linked through their
+    // left links. Visited nodes only have their left link overwritten, which
+    // finding the successor of the ones after them doesn't read.
+    Node* flatten()
+    {
+        Node* head = nullptr;
+        Node* tail = nullptr;
+        auto node = empty() ? &m_sentinel : const_cast<Node*>(firstOf(leftmost()));
+        while (node != &m_sentinel) {
+            auto following = next(node);
+            if (tail) {
+                tail->setLeft(node);
+            } else {
+                head = node;
+            }
+            tail = node;
+            node = following;
+        }
+        if (tail) {
+            tail->setLeft(nullptr);
+        }
+        adopt(nullptr, nullptr, nullptr);
+        return head;
+    }
+    
+    // make the nodes rooted at `root' the tree, or empty it for null
+    void adopt(Node* root, Node* first, Node* last)
+    {
+        if (!root) {
+            setRoot(nullptr);
+            setLeftMost(&m_sentinel);
+            setRightMost(&m_sentinel);
+            return;
+        }
+        setRoot(root);
+        setLeftMost(first);
+        setRightMost(last);
+        root->setParent(&m_sentinel);
+    }
+    
+    // the number of nodes build() puts in the tree for a flattened list
+    std::size_t countKeys(const Node* head) const
+    {
+        std::size_t count = 0;
+        for (const Node* prev = nullptr; head; prev = head, head = head->left()) {
+            if (!chained || !prev || compare(*keyOf(prev), *keyOf(head))) {
+                ++count;
+            }
+        }
+        return count;
+    }
+    
+    // Builds a perfectly balanced tree of the `count' distinct keys of
+    // `source'. All the levels but the deepest are full, so all the nodes
+    // are black but those on the deepest level, which are red.
+    template<typename Source>
+    void build(Source& source, std::size_t count)
+    {
+        assert(empty());
+        if (!count) {
+            return;
+        }
+        std::size_t maxDepth = 0;
+        while (count >> (maxDepth + 1)) {
+            ++maxDepth;
+        }
+        Node* first = nullptr;
+        Node* last = nullptr;
+        auto node = buildSubtree(source, count, 0, maxDepth, first, last);
+        assert(!source.peek());
+        adopt(node, first, last);
+        validate();
+    }
+    
+    template<typename Source>
+    Node* buildSubtree(Source& source, std::size_t count, std::size_t depth, std::size_t maxDepth,
+                             Node*& first, Node*& last)
+    {
+        if (!count) {
+            return nullptr;
+        }
+        auto leftCount = (count - 1) / 2;
+        auto left = buildSubtree(source, leftCount, depth + 1, maxDepth, first, last);
+        auto node = source.take();
+        node->reset();
+        if constexpr (chained) {
+            // the last key of a run goes in the tree, iterated after the
+            // others, which stay in order
+            node->setChainPrev(node);
+            node->setChainNext(node);
+            for (auto duplicate = source.peek(); duplicate && !compare(*node, *duplicate); duplicate = source.peek()) {
+                source.take();
+                duplicate->reset();
+                addDuplicate(*duplicate, *node);
+                node = duplicate;
+            }
+        }
+        if (!first) {
+            first = node;
+        }
+        last = node;
+        auto right = buildSubtree(source, count - 1 - leftCount, depth + 1, maxDepth, first, last);
+        node->setLeft(left);
+        node->setRight(right);
+        if (left) {
+            left->setParent(node);
+        }
+        if (right) {
+            right->setParent(node);
+        }
+        node->setColor(depth && depth == maxDepth ? Node::red : Node::black);
+        if constexpr (augmented) {
+            augment(node);
+        }
+        return node;
+    }
+    
+    template<typename A, typename B>
+    bool compare(const A& a, const B& b) const
+    {
+        return static_cast<const Comp&>(*this)(a, b);
+    }
+    
+    // the first node not less than `key' in the subtree of `cur', or
+    // `res' if there is none
+    template<typename K>
+    const Node* lowerBoundIn(const Node* cur, const K& key, const Node* res) const
+    {
         while (cur) {
             if (compare(static_cast<const Key&>(*cur), key)) {
                 cur = cur->right();
-            }  else {
+            } else {
                 res = cur;
                 cur = cur->left();
             }
         }
-        return { *this, res ? *res : m_sentinel };
+        return res;
+    }
+    
+    template<typename K>
+    const_iterator lowerBoundOf(const K& key) const
+    {
+        auto res = lowerBoundIn(root(), key, nullptr);
+        return { *this, res ? *firstOf(res) : m_sentinel };
+    }
+    
+    template<typename K>
+    const_iterator lowerBoundOf(const K& key, const_iterator hint) const
+    {
+        assert(hint.m_tree == this);
+        const Node* cur = hint.m_node;
+        if (cur == &m_sentinel) {
+            return lowerBoundOf(key);
+        }
+        if constexpr (chained) {
+            // duplicates are ahead of the node in the tree in the ring
+            while (!cur->parent()) {
+                cur = chainNode(cur)->chainPrev();
+            }
+        }
+        // Climb until the subtree of `cur' holds the result. If the hint is
+        // less than the key, the result comes after it and the subtree is
+        // bounded by the first ancestor above it from the left that isn't
+        // less. Otherwise the result is the hint or comes before it, bounded
+        // by the first ancestor above it from the right that is less.
+        const Node* bound = nullptr;
+        bool after = compare(static_cast<const Key&>(*cur), key);
+        while (cur != root()) {
+            auto parent = cur->parent();
+            bool isLeft = cur == parent->left();
+            if (after && isLeft && !compare(static_cast<const Key&>(*parent), key)) {
+                bound = parent;
+                break;
+            }
+            if (!after && !isLeft && compare(static_cast<const Key&>(*parent), key)) {
+                break;
+            }
+            cur = parent;
+        }
+        auto res = lowerBoundIn(cur, key, bound);
+        return { *this, res ? *firstOf(res) : m_sentinel };
+    }
+    
+    template<typename K>
+    const_iterator upperBoundOf(const K& key) const
+    {
+        const Node* res = nullptr;
+        auto cur = root();
+        while (cur) {
+            if (compare(key, static_cast<const Key&>(*cur))) {
+                res = cur;
+                cur = cur->left();
+            } else {
+                cur = cur->right();
+            }
+        }
+        return { *this, res ? *firstOf(res) : m_sentinel };
     }
     
-    const_iterator find(const Key& key) const
+    template<typename K>
+    const_iterator findOf(const K& key) const
     {
-        const RbTreeNode* res = nullptr;
+        const Node* res = nullptr;
         auto cur = root();
         while (cur) {
             if (compare(static_cast<const Key&>(*cur), key)) {
@@ -340,26 +805,136 @@ public:
                 break;
             }
         }
-        return { *this, res ? res : m_sentinel };
+        return { *this, res ? *firstOf(res) : m_sentinel };
     }
-private:
-    bool compare(const Key& a, const Key& b) const
+    
+    static const Key* keyOf(const Node* node)
     {
-        return static_cast<const Comp&>(*this)(a, b);
+        return static_cast<const Key*>(node);
+    }
+    
+    void augment(Node* node)
+    {
+        static_cast<const Augment&>(*this)(static_cast<Key&>(*node), keyOf(node->left()), keyOf(node->right()));
+    }
+    
+    void augmentUp(Node* node)
+    {
+        if constexpr (augmented) {
+            for (; node && node != &m_sentinel; node = node->parent()) {
+                augment(node);
+            }
+        }
+    }
+    
+    static ChainNode* chainNode(const Node* node)
+    {
+        return static_cast<ChainNode*>(const_cast<Node*>(node));
     }
     
-    void insertFixup(RbTreeNode* cur)
+    // the first node in order with the key of `node', a node in the tree
+    const Node* firstOf(const Node* node) const
     {
-        while (cur->parent()->color() == RbTreeNode::red) {
-            assert(cur->color() == RbTreeNode::red);
+        if constexpr (chained) {
+            if (node != &m_sentinel) {
+                return chainNode(node)->chainNext();
+            }
+        }
+        return node;
+    }
+    
+    Node* next(Node* node) const
+    {
+        if constexpr (chained) {
+            // a duplicate is followed by the next one, the last by the node in the tree
+            if (!node->parent()) {
+                return chainNode(node)->chainNext();
+            }
+            return const_cast<Node*>(firstOf(node->successor()));
+        }
+        return node->successor();
+    }
+    
+    Node* prev(Node* node) const
+    {
+        if (node == &m_sentinel) {
+            return rightmost();
+        }
+        if constexpr (chained) {
+            auto chainPrev = chainNode(node)->chainPrev();
+            if (node->parent()) {
+                // the node in the tree comes after its duplicates
+                if (chainPrev != node) {
+                    return chainPrev;
+                }
+            } else if (!chainPrev->parent()) {
+                return chainPrev;
+            } else {
+                // the first duplicate follows the node before the one in the tree
+                return chainPrev->predecessor();
+            }
+        }
+        return node->predecessor();
+    }
+    
+    void addDuplicate(ChainNode& node, ChainNode& inTree)
+    {
+        node.setChainPrev(&inTree);
+        node.setChainNext(inTree.chainNext());
+        inTree.chainNext()->setChainPrev(&node);
+        inTree.setChainNext(&node);
+    }
+    
+    void unlink(ChainNode& node)
+    {
+        node.chainPrev()->setChainNext(node.chainNext());
+        node.chainNext()->setChainPrev(node.chainPrev());
+        node.setChainPrev(nullptr);
+        node.setChainNext(nullptr);
+    }
+    
+    // put `with' into the place of `node' in the tree
+    void replace(Node& node, Node& with)
+    {
+        auto parent = node.parent();
+        with.setLeft(node.left());
+        with.setRight(node.right());
+        with.setParent(parent);
+        with.setColor(node.color());
+        if (node.left()) {
+            node.left()->setParent(&with);
+        }
+        if (node.right()) {
+            node.right()->setParent(&with);
+        }
+        if (&node == root()) {
+            setRoot(&with);
+        } else if (&node == parent->left()) {
+            parent->setLeft(&with);
+        } else {
+            parent->setRight(&with);
+        }
+        if (&node == leftmost()) {
+            setLeftMost(&with);
+        }
+        if (&node == rightmost()) {
+            setRightMost(&with);
+        }
+        node.reset();
+    }
+    
+    void insertFixup(Node* cur)
+    {
+        while (cur->parent()->color() == Node::red) {
+            assert(cur->color() == Node::red);
             auto parent = cur->parent();
             auto grandParent = parent->parent();
             if (parent == grandParent->left()) {
                 auto uncle = grandParent->right();
-                if (uncle && uncle->color() == RbTreeNode::red) {
-                    parent->setColor(RbTreeNode::black);
-                    uncle->setColor(RbTreeNode::black);
-                    grandParent->setColor(RbTreeNode::red);
+                if (uncle && uncle->color() == Node::red) {
+                    parent->setColor(Node::black);
+                    uncle->setColor(Node::black);
+                    grandParent->setColor(Node::red);
                     cur = grandParent;
                 } else {
                     if (cur == parent->right()) {
@@ -368,16 +943,16 @@ private:
                         parent = cur->parent();
                         grandParent = parent->parent();
                     }
-                    parent->setColor(RbTreeNode::black);
-                    grandParent->setColor(RbTreeNode::red);
+                    parent->setColor(Node::black);
+                    grandParent->setColor(Node::red);
                     rightRotate(grandParent);
                 }
             } else {
                 auto uncle = grandParent->left();
-                if (uncle && uncle->color() == RbTreeNode::red) {
-                    parent->setColor(RbTreeNode::black);
-                    uncle->setColor(RbTreeNode::black);
-                    grandParent->setColor(RbTreeNode::red);
+                if (uncle && uncle->color() == Node::red) {
+                    parent->setColor(Node::black);
+                    uncle->setColor(Node::black);
+                    grandParent->setColor(Node::red);
                     cur = grandParent;
                 } else {
                     if (cur == parent->left()) {
@@ -386,45 +961,45 @@ private:
                         parent = cur->parent();
                         grandParent = parent->parent();
                     }
-                    parent->setColor(RbTreeNode::black);
-                    grandParent->setColor(RbTreeNode::red);
+                    parent->setColor(Node::black);
+                    grandParent->setColor(Node::red);
                     leftRotate(grandParent);
                 }
             }
         }
-        root()->setColor(RbTreeNode::black);
+        root()->setColor(Node::black);
     }
 
-    void removeFixup(RbTreeNode* cur, RbTreeNode* parent)
+    void removeFixup(Node* cur, Node* parent)
     {
-        while (cur != root() && (!cur || cur->color() == RbTreeNode::black)) {
+        while (cur != root() && (!cur || cur->color() == Node::black)) {
             if (cur == parent->left()) {
                 auto sibling = parent->right();
                 assert(sibling);
-                if (sibling->color() == RbTreeNode::red) {
-                    sibling->setColor(RbTreeNode::black);
-                    parent->setColor(RbTreeNode::red);
+                if (sibling->color() == Node::red) {
+                    sibling->setColor(Node::black);
+                    parent->setColor(Node::red);
                     leftRotate(parent);
                     sibling = parent->right();
                 }
-                if ((!sibling->left() || sibling->left()->color() == RbTreeNode::black) &&
-                    (!sibling->right() || sibling->right()->color() == RbTreeNode::black)) {
-                    sibling->setColor(RbTreeNode::red);
+                if ((!sibling->left() || sibling->left()->color() == Node::black) &&
+                    (!sibling->right() || sibling->right()->color() == Node::black)) {
+                    sibling->setColor(Node::red);
                     cur = parent;
                     parent = cur->parent();
                 } else {
-                    if (!sibling->right() || sibling->right()->color() == RbTreeNode::black) {
+                    if (!sibling->right() || sibling->right()->color() == Node::black) {
                         if (sibling->left()) {
-                            sibling->left()->setColor(RbTreeNode::black);
+                            sibling->left()->setColor(Node::black);
                         }
-                        sibling->setColor(RbTreeNode::red);
+                        sibling->setColor(Node::red);
                         rightRotate(sibling);
                         sibling = parent->right();
                     }
                     sibling->setColor(parent->color());
-                    parent->setColor(RbTreeNode::black);
+                    parent->setColor(Node::black);
                     if (sibling->right()) {
-                        sibling->right()->setColor(RbTreeNode::black);
+                        sibling->right()->setColor(Node::black);
                     }
                     leftRotate(parent);
                     cur = root();
@@ -432,30 +1007,30 @@ private:
             } else {
                 auto sibling = parent->left();
                 assert(sibling);
-                if (sibling->color() == RbTreeNode::red) {
-                    sibling->setColor(RbTreeNode::black);
-                    parent->setColor(RbTreeNode::red);
+                if (sibling->color() == Node::red) {
+                    sibling->setColor(Node::black);
+                    parent->setColor(Node::red);
                     rightRotate(parent);
                     sibling = parent->left();
                 }
-                if ((!sibling->left() || sibling->left()->color() == RbTreeNode::black) &&
-                    (!sibling->right() || sibling->right()->color() == RbTreeNode::black)) {
-                    sibling->setColor(RbTreeNode::red);
+                if ((!sibling->left() || sibling->left()->color() == Node::black) &&
+                    (!sibling->right() || sibling->right()->color() == Node::black)) {
+                    sibling->setColor(Node::red);
                     cur = parent;
                     parent = cur->parent();
                 } else {
-                    if (!sibling->left() || sibling->left()->color() == RbTreeNode::black) {
+                    if (!sibling->left() || sibling->left()->color() == Node::black) {
                         if (sibling->right()) {
-                            sibling->right()->setColor(RbTreeNode::black);
+                            sibling->right()->setColor(Node::black);
                         }
-                        sibling->setColor(RbTreeNode::red);
+                        sibling->setColor(Node::red);
                         leftRotate(sibling);
                         sibling = parent->left();
                     }
                     sibling->setColor(parent->color());
-                    parent->setColor(RbTreeNode::black);
+                    parent->setColor(Node::black);
                     if (sibling->left()) {
-                        sibling->left()->setColor(RbTreeNode::black);
+                        sibling->left()->setColor(Node::black);
                     }
                     rightRotate(parent);
                     cur = root();
@@ -463,11 +1038,11 @@ private:
             }
         }
         if (cur) {
-            cur->setColor(RbTreeNode::black);
+            cur->setColor(Node::black);
         }
     }
     
-    void leftRotate(RbTreeNode* node)
+    void leftRotate(Node* node)
     {
         if (!node->right()) { return; }
         
@@ -488,9 +1063,13 @@ private:
         }
         node->setParent(right);
         right->setLeft(node);
+        if constexpr (augmented) {
+            augment(node);
+            augment(right);
+        }
     }
     
-    void rightRotate(RbTreeNode* node)
+    void rightRotate(Node* node)
     {
         if (!node->left()) { return; }
         
@@ -511,19 +1090,23 @@ private:
         }
         node->setParent(left);
         left->setRight(node);
+        if constexpr (augmented) {
+            augment(node);
+            augment(left);
+        }
     }
 
     void validate()
     {
 #ifndef NDEBUG
-        assert(!root() || root()->color() == RbTreeNode::black);
+        assert(!root() || root()->color() == Node::black);
         assert(!root() || root()->parent() == &m_sentinel);
         validate(root());
 #endif
     }
     
 #ifndef NDEBUG
-    int validate(RbTreeNode* key) const
+    int validate(Node* key) const
     {
         if (!key) { return 0; }
         
@@ -536,20 +1119,20 @@ private:
         auto lbh = validate(key->left());
         auto rbh = validate(key->right());
         assert(lbh == rbh);
-        return lbh + key->color() == RbTreeNode::black;
+        return lbh + key->color() == Node::black;
     }
 #endif
     
-    RbTreeNode* root() const { return m_sentinel.parent(); }
-    void setRoot(RbTreeNode* root) { m_sentinel.setParent(root); }
+    Node* root() const { return m_sentinel.parent(); }
+    void setRoot(Node* root) { m_sentinel.setParent(root); }
     
-    RbTreeNode* leftmost() const { return m_sentinel.left(); }
-    void setLeftMost(RbTreeNode* node) { m_sentinel.setLeft(node); }
+    Node* leftmost() const { return m_sentinel.left(); }
+    void setLeftMost(Node* node) { m_sentinel.setLeft(node); }
     
-    RbTreeNode* rightmost() const { return m_sentinel.right(); }
-    void setRightMost(RbTreeNode* node) { m_sentinel.setRight(node); }
+    Node* rightmost() const { return m_sentinel.right(); }
+    void setRightMost(Node* node) { m_sentinel.setRight(node); }
     
-    RbTreeNode m_sentinel;
+    Node m_sentinel;
 };
 
 template<typename Tree, typename Key, typename Comp>
@@ -562,18 +1145,20 @@ public:
     using iterator_category = std::bidirectional_iterator_tag;
     using difference_type = std::ptrdiff_t;
 private:
+    using Node = typename Tree::Node;
+    
     friend Tree;
     
     template<typename T, typename U, typename V>
     friend class RbTreeIterator;
     
-    RbTreeIterator(const Tree& tree, const RbTreeNode& node)
+    RbTreeIterator(const Tree& tree, const Node& node)
         : m_tree(const_cast<Tree*>(&tree))
-        , m_node(const_cast<RbTreeNode*>(&node))
+        , m_node(const_cast<Node*>(&node))
     {
     }
     
-    RbTreeIterator(Tree& tree, RbTreeNode& node)
+    RbTreeIterator(Tree& tree, Node& node)
         : m_tree(&tree)
         , m_node(&node)
     {
@@ -588,7 +1173,7 @@ public:
     RbTreeIterator& operator++()
     {
         assert(m_node != &m_tree->m_sentinel);
-        m_node = m_node->successor();
+        m_node = m_tree->next(m_node);
         return *this;
     }
 
@@ -596,13 +1181,13 @@ public:
     {
         auto tmp = *this;
         ++*this;
-        return *this;
+        return tmp;
     }
     
     RbTreeIterator& operator--()
     {
         assert(!m_tree->empty());
-        m_node = m_node == &m_tree->m_sentinel ? m_tree->rightmost() : m_node->predecessor();
+        m_node = m_tree->prev(m_node);
         return *this;
     }
     
@@ -610,7 +1195,7 @@ public:
     {
         auto tmp = *this;
         --*this;
-        return *this;
+        return tmp;
     }
     
     reference operator *() const
@@ -636,7 +1221,7 @@ public:
     }
 private:
     Tree* m_tree;
-    RbTreeNode* m_node;
+    Node* m_node;
 };
 
 #endif /* RB_TREE_H */
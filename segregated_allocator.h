@@ -10,25 +10,85 @@
 #define SEGREGATED_ALLOCATOR_H
 
 #include "free_list.h"
+#include "bitmap_slab.h"
+#include "size_classes.h"
 #include "list.h"
 #include "os_memory.h"
+#include "trace_path.h"
 
 #include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <vector>
 #include <algorithm>
+#include <type_traits>
 
 namespace memory
 {
     
-template<std::size_t MaxBins>
+// Slab manages the blocks inside a page, either FreeList or BitmapSlab.
+// SizeClasses maps request sizes to bins, at most MaxBins classes are used, and
+// only those whose blocks fit a page.
+template<std::size_t MaxBins, typename Slab = FreeList, typename SizeClasses = LinearSizeClasses>
 class SegregatedAllocator
 {
     static_assert(MaxBins > 0);
+    
+    struct Page;
 public:
+    // Pages still in use by the heap of an exited thread. The heaps sharing the
+    // pool adopt them, along with the blocks other threads freed meanwhile, when
+    // a bin runs out of pages.
+    class AbandonedPool
+    {
+        friend class SegregatedAllocator;
+    public:
+        AbandonedPool() = default;
+        AbandonedPool(const AbandonedPool&) = delete;
+        AbandonedPool& operator =(const AbandonedPool&) = delete;
+        
+        ~AbandonedPool()
+        {
+            for (auto& list : m_pages) {
+                for (auto cur = list.first(); cur; ) {
+                    auto next = cur->next();
+                    unmapPage(*cur);
+                    cur = next;
+                }
+            }
+            for (auto file : m_pageFiles) {
+                vmClosePageFile(file);
+            }
+        }
+    private:
+        std::mutex m_mutex;
+        List<Page> m_pages[MaxBins];
+        // the page files of the meshing heaps which abandoned pages here
+        std::vector<int> m_pageFiles;
+    };
+    
     SegregatedAllocator(std::size_t minBinSize, std::size_t sizeStep)
+        : SegregatedAllocator(SizeClasses(Slab::adjustBlockSize(minBinSize),
+                                          Slab::adjustBlockSize(sizeStep),
+                                          MaxBins))
+    {
+    }
+    
+    explicit SegregatedAllocator(const SizeClasses& sizeClasses = SizeClasses())
+        : m_sizeClasses(sizeClasses)
     {
-        assert(minBinSize > 0 && sizeStep > 0);
-        m_minBinSize = FreeList::adjustBlockSize(minBinSize);
-        m_sizeStep = FreeList::adjustBlockSize(sizeStep);
+        assert(m_sizeClasses.count() <= MaxBins);
+        // a larger class would map a page for every request and find no room in it
+        while (m_numBins < m_sizeClasses.count() &&
+               Slab::capacityFor(vmPageSize() - sizeof(Page), binSize(m_numBins))) {
+            ++m_numBins;
+        }
+        assert(m_numBins);
     }
     
     SegregatedAllocator(const SegregatedAllocator&) = delete;
@@ -38,64 +98,767 @@ public:
     
     ~SegregatedAllocator()
     {
-        for (auto& list : m_pageLists) {
-            for (auto cur = list.first(); cur; ) {
-                auto next = cur->next();
-                vmDeallocate(cur, vmPageSize());
-                cur = next;
+        reserveInBackground(0);
+        for (std::size_t bin = 0; bin < MaxBins; ++bin) {
+            while (auto p = takeReadyPage(bin)) {
+                vmDeallocate(p, vmPageSize());
+            }
+        }
+        for (auto& queues : m_pageQueues) {
+            for (auto& queue : queues) {
+                for (auto cur = queue.first(); cur; ) {
+                    auto next = cur->next();
+                    releasePage(*cur);
+                    cur = next;
+                }
+            }
+        }
+        if (m_pageFile >= 0) {
+            vmClosePageFile(m_pageFile);
+        }
+    }
+    
+    // the number of physical pages currently in use
+    std::size_t pageCount() const { return m_pageCount; }
+    
+    // adopt abandoned pages from `pool' before mapping new ones
+    void setAbandonedPool(AbandonedPool* pool) { m_abandonedPool = pool; }
+    
+    // Hand the pages still in use over to the abandoned pool and release the
+    // others, the page file of a meshing heap goes along with them. Called by
+    // the owning thread when it exits, the heap isn't used afterwards.
+    void abandon()
+    {
+        assert(m_abandonedPool);
+        std::lock_guard<std::mutex> lock(m_abandonedPool->m_mutex);
+        for (std::size_t bin = 0; bin < MaxBins; ++bin) {
+            for (auto& queue : m_pageQueues[bin]) {
+                while (auto page = queue.first()) {
+                    dequeue(*page);
+                    collectThreadFrees(*page);
+                    --m_pageCount;
+                    if (!page->used) {
+                        releasePage(*page);
+                        continue;
+                    }
+                    // other threads free into the thread free list from now on
+                    page->owner.store(nullptr, std::memory_order_release);
+                    m_abandonedPool->m_pages[bin].addFirst(*page);
+                }
             }
         }
+        // the pages handed over still live in the page file
+        if (m_pageFile >= 0) {
+            m_abandonedPool->m_pageFiles.push_back(m_pageFile);
+            m_pageFile = -1;
+            m_freeFileOffsets.clear();
+        }
+    }
+    
+    // take back the blocks other threads have freed
+    void collect()
+    {
+        for (auto& queues : m_pageQueues) {
+            for (auto& queue : queues) {
+                for (auto page = queue.first(); page; ) {
+                    auto next = page->next();
+                    if (collectThreadFrees(*page)) {
+                        requeue(*page);
+                    }
+                    page = next;
+                }
+            }
+        }
+    }
+    
+    // Back the pages by a page file so that sparsely used pages can be meshed,
+    // mesh() is run every `period' frees unless it is 0. Must be called before
+    // anything is allocated or reserved, returns false if page files are not supported.
+    bool enableMeshing(std::size_t period = 0)
+    {
+        static_assert(std::is_same_v<Slab, BitmapSlab>, "meshing needs the occupancy bitmap of BitmapSlab");
+        assert(!m_pageCount && m_pageFile < 0);
+        // pages reserved ahead of time are anonymous and couldn't be meshed
+        assert(std::all_of(std::begin(m_readyPages), std::end(m_readyPages),
+                           [](const ReadyPages& ready) { return !ready.count.load(std::memory_order_relaxed); }));
+        m_pageFile = vmCreatePageFile();
+        m_meshPeriod = period;
+        return m_pageFile >= 0;
+    }
+    
+    // Merges pairs of sparsely used pages of a bin whose blocks in use don't
+    // overlap: the blocks of one page are copied into the other, and its virtual
+    // page is remapped onto the physical page of the other, so no pointer
+    // changes. Returns the number of physical pages released.
+    std::size_t mesh()
+    {
+        static_assert(std::is_same_v<Slab, BitmapSlab>, "meshing needs the occupancy bitmap of BitmapSlab");
+        if (m_pageFile < 0) {
+            return 0;
+        }
+        MEMORY_TRACE_PATH(segregatedMesh);
+        // the usage and the occupancy have to count the blocks other threads freed
+        collect();
+        
+        std::size_t released = 0;
+        std::vector<Page*> candidates;
+        for (std::size_t bin = 0; bin < MaxBins; ++bin) {
+            // pages at most half used
+            candidates.clear();
+            for (std::size_t queue = 1; queue <= numPartialQueues / 2; ++queue) {
+                for (auto page = m_pageQueues[bin][queue].first(); page; page = page->next()) {
+                    // a page adopted from another heap lives in the page file of that heap
+                    if (page->numAliases < maxMeshAliases && page->pageFile == m_pageFile) {
+                        candidates.push_back(page);
+                    }
+                }
+            }
+            
+            for (std::size_t i = 0; i < candidates.size(); ++i) {
+                auto page = candidates[i];
+                if (!page) {
+                    continue;
+                }
+                auto last = std::min(candidates.size(), i + 1 + maxMeshProbes);
+                for (auto j = i + 1; j < last && page->numAliases < maxMeshAliases; ++j) {
+                    auto other = candidates[j];
+                    // blocks sit at the same offsets only in pages of the same color
+                    if (other && page->color == other->color &&
+                        page->numAliases + other->numAliases < maxMeshAliases &&
+                        page->used + other->used <= page->slab.capacity() &&
+                        !page->slab.overlaps(other->slab)) {
+                        // the next ones would fail the same way
+                        if (!meshPages(*page, *other)) {
+                            return released;
+                        }
+                        candidates[j] = nullptr;
+                        ++released;
+                    }
+                }
+            }
+        }
+        return released;
+    }
+    
+    // Maps and faults in pages ahead of time until `bin' has `count' of them
+    // ready, so a bin running out of pages costs neither a syscall nor a page
+    // fault. May be called from any thread, not with meshing. Returns the
+    // number of pages ready.
+    std::size_t reserve(std::size_t bin, std::size_t count)
+    {
+        assert(bin < m_numBins && m_pageFile < 0);
+        // callers topping up at once would each map what is missing
+        std::lock_guard<std::mutex> lock(m_reserveMutex);
+        auto& ready = m_readyPages[bin];
+        auto have = ready.count.load(std::memory_order_relaxed);
+        if (have >= count) {
+            return have;
+        }
+        // one syscall for all of them, they are unmapped one by one later
+        auto n = count - have;
+        auto p = static_cast<char*>(vmAllocatePopulated(n * vmPageSize()));
+        if (!p) {
+            return have;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            auto page = p + i * vmPageSize();
+            auto head = ready.head.load(std::memory_order_relaxed);
+            do {
+                *reinterpret_cast<void**>(page) = head;
+            } while (!ready.head.compare_exchange_weak(head, page, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+            ready.count.fetch_add(1, std::memory_order_relaxed);
+        }
+        return have + n;
+    }
+    
+    // the number of pages reserve() has ready for `bin'
+    std::size_t readyPageCount(std::size_t bin) const
+    {
+        return m_readyPages[bin].count.load(std::memory_order_relaxed);
+    }
+    
+    // Keeps `count' pages ready for every bin from a background thread, which
+    // checks every `period'. A count of 0 stops the thread.
+    void reserveInBackground(std::size_t count, std::chrono::milliseconds period = std::chrono::milliseconds(1))
+    {
+        if (m_reserveThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_reserveMutex);
+                m_stopReserving = true;
+            }
+            m_reserveWakeup.notify_one();
+            m_reserveThread.join();
+            m_stopReserving = false;
+        }
+        if (!count) {
+            return;
+        }
+        assert(m_pageFile < 0);
+        m_reserveThread = std::thread([this, count, period] {
+            std::unique_lock<std::mutex> lock(m_reserveMutex);
+            while (!m_stopReserving) {
+                lock.unlock();
+                for (std::size_t bin = 0; bin < m_numBins; ++bin) {
+                    reserve(bin, count);
+                }
+                lock.lock();
+                m_reserveWakeup.wait_for(lock, period, [this] { return m_stopReserving; });
+            }
+        });
     }
     
     std::size_t maxBinSize() const
     {
-        return m_minBinSize + m_sizeStep * (MaxBins - 1);
+        return binSize(m_numBins - 1);
+    }
+    
+    // size a request of `size' bytes is rounded up to, or 0 if it cannot be served
+    std::size_t goodSize(std::size_t size) const
+    {
+        auto bin = binIndex(size);
+        return bin < MaxBins ? binSize(bin) : 0;
+    }
+    
+    std::size_t usableSize(const void* p) const
+    {
+        assert(p);
+        return pageOf(p)->slab.blockSize();
     }
     
     void* malloc(std::size_t size)
     {
-        auto bin = (std::max(size, m_minBinSize) - m_minBinSize + m_sizeStep - 1) / m_sizeStep;
-        if (bin >= MaxBins) {
+        auto page = pageFor(size);
+        if (!page) {
             return nullptr;
         }
-        
-        auto page = m_pageLists[bin].first();
-        if (!page || page->freeList.empty()) {
-            char* p = static_cast<char*>(vmAllocate(vmPageSize()));
-            if (!p) {
-                return nullptr;
+        auto p = page->slab.malloc();
+        allocated(*page, 1);
+        return p;
+    }
+    
+    void* calloc(std::size_t count, std::size_t size)
+    {
+        if (size && count > std::numeric_limits<std::size_t>::max() / size) {
+            return nullptr;
+        }
+        // blocks of a fresh page are only cleared if they have been used before
+        auto page = pageFor(count * size);
+        if (!page) {
+            return nullptr;
+        }
+        auto p = page->slab.calloc();
+        allocated(*page, 1);
+        return p;
+    }
+    
+    // allocate up to `count' blocks of `size' bytes, returns the number of blocks allocated
+    std::size_t mallocBatch(std::size_t size, void** out, std::size_t count)
+    {
+        std::size_t n = 0;
+        while (n < count) {
+            auto page = pageFor(size);
+            if (!page) {
+                break;
             }
-            page = new (p) Page;
-            page->freeList = FreeList(p + sizeof(Page), p + vmPageSize(), m_minBinSize + bin * m_sizeStep);
-            page->list = &m_pageLists[bin];
-            m_pageLists[bin].addFirst(*page);
+            auto got = page->slab.mallocBatch(out + n, count - n);
+            allocated(*page, got);
+            n += got;
         }
-        return page->freeList.malloc();
+        return n;
     }
     
     void free(void* p)
     {
         if (p) {
-            auto page = alignedCast<Page*>(roundDownPowerOfTwo(p, vmPageSize()));
-            bool wasEmpty = page->freeList.empty();
-            page->freeList.free(p);
-            if (wasEmpty && page != page->list->first()) {
-                assert(page->list->first());
-                page->list->remove(*page);
-                page->list->insertAfter(*page, *page->list->first());
+            auto base = pageOf(p);
+            // a meshed virtual page shares the header of the page it was merged into
+            auto page = base->self;
+            p = pointerAdd(page, pointerDistanceTo(base, p));
+            // the block belongs to the heap of another thread, or to nobody if it was abandoned
+            if (page->owner.load(std::memory_order_relaxed) != this) {
+                pushThreadFree(*page, p);
+                return;
+            }
+            page->slab.free(p);
+            assert(page->used);
+            if (--page->used < page->queueLow) {
+                requeue(*page);
+            }
+            if constexpr (std::is_same_v<Slab, BitmapSlab>) {
+                if (m_meshPeriod && ++m_freesSinceMesh >= m_meshPeriod) {
+                    m_freesSinceMesh = 0;
+                    mesh();
+                }
+            }
+        }
+    }
+    
+    // Free `count' blocks. A page is only requeued once for a run of blocks
+    // in it, so blocks sorted or allocated together are cheaper to free this
+    // way than one by one.
+    void freeBatch(void* const* blocks, std::size_t count)
+    {
+        Page* run = nullptr;
+        std::size_t freed = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            auto p = blocks[i];
+            if (!p) {
+                continue;
+            }
+            auto base = pageOf(p);
+            auto page = base->self;
+            p = pointerAdd(page, pointerDistanceTo(base, p));
+            if (page->owner.load(std::memory_order_relaxed) != this) {
+                pushThreadFree(*page, p);
+                continue;
+            }
+            // a page is only released once it is empty, so none of the
+            // blocks left can lie in the page of a finished run
+            if (page != run) {
+                if (run && run->used < run->queueLow) {
+                    requeue(*run);
+                }
+                run = page;
+            }
+            page->slab.free(p);
+            assert(page->used);
+            --page->used;
+            ++freed;
+        }
+        if (run && run->used < run->queueLow) {
+            requeue(*run);
+        }
+        if constexpr (std::is_same_v<Slab, BitmapSlab>) {
+            if (m_meshPeriod && (m_freesSinceMesh += freed) >= m_meshPeriod) {
+                m_freesSinceMesh = 0;
+                mesh();
             }
         }
     }
 private:
+    // Pages of a bin are queued by how many of their blocks are in use: queue 0
+    // holds empty pages, queue fullQueue the full ones, and the queues between
+    // partially used pages, fuller pages in higher queues. Allocating from the
+    // fullest page which still has room lets sparse pages drain so they can be
+    // given back to the OS.
+    static constexpr std::size_t numPartialQueues = 4;
+    static constexpr std::size_t fullQueue = numPartialQueues + 1;
+    static constexpr std::size_t numQueues = numPartialQueues + 2;
+    // the most virtual pages meshed into one physical page, besides its own
+    static constexpr std::size_t maxMeshAliases = 3;
+    // how many following candidates each page is tried to mesh with
+    static constexpr std::size_t maxMeshProbes = 64;
+    // how many full pages are checked for blocks freed by other threads on a page miss
+    static constexpr std::size_t maxCollectProbes = 8;
+    
     struct Page : ListNode<Page>
     {
-        FreeList freeList;
-        List<Page>* list = nullptr;
+        // the header of the page, not the one of a virtual page meshed into it
+        Page* self = this;
+        // the heap allocating from the page, null while the page is abandoned
+        std::atomic<SegregatedAllocator*> owner{ nullptr };
+        // blocks freed by threads other than the owner, linked through their first word
+        std::atomic<void*> threadFree{ nullptr };
+        Slab slab;
+        std::uint32_t bin = 0;
+        std::uint32_t queue = 0;
+        std::uint32_t used = 0;
+        // the page stays in its queue while used is in [queueLow, queueHigh)
+        std::uint32_t queueLow = 0;
+        std::uint32_t queueHigh = 0;
+        // how many cache lines the first block is moved past the header
+        std::uint32_t color = 0;
+        // the virtual pages meshed into this one
+        std::uint32_t numAliases = 0;
+        void* aliases[maxMeshAliases] = {};
+        // the page file backing the page when meshing is enabled, -1 otherwise
+        int pageFile = -1;
+        // where the page lives in it
+        std::size_t fileOffset = 0;
     };
     
-    List<Page> m_pageLists[MaxBins];
-    std::size_t m_minBinSize;
-    std::size_t m_sizeStep;
+    // Pages faulted in ahead of time, linked through their first word. Any
+    // thread may push, only the owner pops, so a popped page can't come back
+    // while another pop is under way.
+    struct ReadyPages
+    {
+        std::atomic<void*> head{ nullptr };
+        std::atomic<std::size_t> count{ 0 };
+    };
+    
+    // a page of the bin with a free block, a new page is mapped if there is none
+    Page* pageFor(std::size_t size)
+    {
+        auto bin = binIndex(size);
+        if (bin >= MaxBins) {
+            return nullptr;
+        }
+        
+        // blocks other threads freed may have left the page empty, which is
+        // only released once they are taken back
+        while (auto page = fullestPage(bin)) {
+            if (!page->threadFree.load(std::memory_order_relaxed)) {
+                return page;
+            }
+            collectThreadFrees(*page);
+            requeue(*page);
+        }
+        if (auto page = reclaimPage(bin)) {
+            MEMORY_TRACE_PATH(segregatedReclaim);
+            return page;
+        }
+        
+        std::size_t fileOffset = 0;
+        char* p = takeReadyPage(bin);
+        if (p) {
+            MEMORY_TRACE_PATH(segregatedReadyPage);
+        } else {
+            MEMORY_TRACE_PATH(segregatedNewPage);
+            p = mapPage(fileOffset);
+        }
+        if (!p) {
+            return nullptr;
+        }
+        auto page = new (p) Page;
+        page->pageFile = m_pageFile;
+        page->fileOffset = fileOffset;
+        page->color = nextColor(bin);
+        // new pages are zero filled
+        page->slab = Slab(p + sizeof(Page) + page->color * cacheLineSize, p + vmPageSize(), binSize(bin), true);
+        if (!page->slab.capacity()) {
+            releasePage(*page);
+            return nullptr;
+        }
+        ++m_pageCount;
+        page->owner.store(this, std::memory_order_relaxed);
+        page->bin = static_cast<std::uint32_t>(bin);
+        enqueue(*page, 0);
+        return page;
+    }
+    
+    // Block k of every page would otherwise sit at the same page offset and
+    // compete for the same cache sets. Successive pages of a bin move their
+    // first block by one more cache line, as long as the slack at the end of
+    // the page leaves the capacity unchanged.
+    std::uint32_t nextColor(std::size_t bin)
+    {
+        auto available = vmPageSize() - sizeof(Page);
+        auto color = m_nextColors[bin];
+        if (color && (color * cacheLineSize > available ||
+                      Slab::capacityFor(available - color * cacheLineSize, binSize(bin)) <
+                      Slab::capacityFor(available, binSize(bin)))) {
+            color = 0;
+        }
+        m_nextColors[bin] = color + 1;
+        return color;
+    }
+    
+    // the first page of the fullest queue with a page which is not full
+    Page* fullestPage(std::size_t bin)
+    {
+        if (auto nonFull = m_nonEmptyQueues[bin] & ((1u << fullQueue) - 1)) {
+            auto queue = sizeof(std::uint64_t) * 8 - 1 - countLeadingZeros(nonFull);
+            return m_pageQueues[bin][queue].first();
+        }
+        return nullptr;
+    }
+    
+    // Look for room freed by other threads in a few of the full pages, then
+    // adopt abandoned pages, returns a page with a free block if any.
+    Page* reclaimPage(std::size_t bin)
+    {
+        auto& full = m_pageQueues[bin][fullQueue];
+        for (std::size_t i = 0; i < maxCollectProbes && full.first(); ++i) {
+            auto page = full.first();
+            if (collectThreadFrees(*page)) {
+                requeue(*page);
+                return fullestPage(bin);
+            }
+            // check the others next time
+            full.remove(*page);
+            full.addLast(*page);
+        }
+        
+        if (!m_abandonedPool) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(m_abandonedPool->m_mutex);
+        auto& abandoned = m_abandonedPool->m_pages[bin];
+        while (auto page = abandoned.first()) {
+            abandoned.remove(*page);
+            page->owner.store(this, std::memory_order_relaxed);
+            collectThreadFrees(*page);
+            ++m_pageCount;
+            if (!page->used) {
+                --m_pageCount;
+                releasePage(*page);
+                continue;
+            }
+            enqueue(*page, queueOf(*page));
+            if (page->queue != fullQueue) {
+                return page;
+            }
+        }
+        return nullptr;
+    }
+    
+    void pushThreadFree(Page& page, void* p)
+    {
+        auto head = page.threadFree.load(std::memory_order_relaxed);
+        do {
+            *static_cast<void**>(p) = head;
+        } while (!page.threadFree.compare_exchange_weak(head, p, std::memory_order_release,
+                                                        std::memory_order_relaxed));
+    }
+    
+    // move the blocks freed by other threads to the slab, returns the number of blocks
+    std::size_t collectThreadFrees(Page& page)
+    {
+        std::size_t n = 0;
+        for (auto p = page.threadFree.exchange(nullptr, std::memory_order_acquire); p; ) {
+            auto next = *static_cast<void**>(p);
+            // a thread which looked the page up before it was meshed leaves
+            // the address in one of the virtual pages remapped onto it, and
+            // before a mesh was undone one that is back in the other page
+            auto base = pageOf(p);
+            auto owner = base->self;
+            p = pointerAdd(owner, pointerDistanceTo(base, p));
+            if (owner != &page) {
+                pushThreadFree(*owner, p);
+            } else {
+                page.slab.free(p);
+                ++n;
+            }
+            p = next;
+        }
+        assert(page.used >= n);
+        page.used -= static_cast<std::uint32_t>(n);
+        return n;
+    }
+    
+    void allocated(Page& page, std::size_t count)
+    {
+        page.used += static_cast<std::uint32_t>(count);
+        if (page.used >= page.queueHigh) {
+            requeue(page);
+        }
+    }
+    
+    // move the page to the queue matching its usage, empty pages beyond the
+    // first one of the bin are released
+    void requeue(Page& page)
+    {
+        auto queue = queueOf(page);
+        dequeue(page);
+        if (queue == 0 && !m_pageQueues[page.bin][0].empty()) {
+            --m_pageCount;
+            releasePage(page);
+            return;
+        }
+        enqueue(page, queue);
+    }
+    
+    // a page reserve() has faulted in, null if there is none
+    char* takeReadyPage(std::size_t bin)
+    {
+        auto& ready = m_readyPages[bin];
+        auto head = ready.head.load(std::memory_order_acquire);
+        while (head && !ready.head.compare_exchange_weak(head, *static_cast<void**>(head),
+                                                         std::memory_order_acquire)) {
+        }
+        if (!head) {
+            return nullptr;
+        }
+        ready.count.fetch_sub(1, std::memory_order_relaxed);
+        // the page reads as zeros again
+        *static_cast<void**>(head) = nullptr;
+        return static_cast<char*>(head);
+    }
+    
+    char* mapPage(std::size_t& fileOffset)
+    {
+        if (m_pageFile < 0) {
+            return static_cast<char*>(vmAllocate(vmPageSize()));
+        }
+        
+        if (!m_freeFileOffsets.empty()) {
+            fileOffset = m_freeFileOffsets.back();
+            m_freeFileOffsets.pop_back();
+        } else {
+            if (!vmResizePageFile(m_pageFile, m_pageFileSize + vmPageSize())) {
+                return nullptr;
+            }
+            fileOffset = m_pageFileSize;
+            m_pageFileSize += vmPageSize();
+        }
+        auto p = static_cast<char*>(vmMapPageFile(m_pageFile, fileOffset, vmPageSize()));
+        if (!p) {
+            m_freeFileOffsets.push_back(fileOffset);
+        }
+        return p;
+    }
+    
+    // unmap the page along with the virtual pages meshed into it
+    void releasePage(Page& page)
+    {
+        auto pageFile = page.pageFile;
+        auto fileOffset = page.fileOffset;
+        unmapPage(page);
+        // the room in the page file of another heap isn't reused
+        if (pageFile >= 0 && pageFile == m_pageFile) {
+            m_freeFileOffsets.push_back(fileOffset);
+        }
+    }
+    
+    // unmap the page and its aliases, and give its room in the page file back
+    static void unmapPage(Page& page)
+    {
+        MEMORY_TRACE_PATH(segregatedReleasePage);
+        auto pageFile = page.pageFile;
+        auto fileOffset = page.fileOffset;
+        for (std::uint32_t i = page.numAliases; i-- > 0; ) {
+            vmDeallocate(page.aliases[i], vmPageSize());
+        }
+        vmDeallocate(&page, vmPageSize());
+        if (pageFile >= 0) {
+            vmPunchPageFile(pageFile, fileOffset, vmPageSize());
+        }
+    }
+    
+    // Merge `other' into `page'. Returns false if a virtual page couldn't be
+    // remapped, e.g. for the limit on the number of mappings, both pages are
+    // left as they were then.
+    bool meshPages(Page& page, Page& other)
+    {
+        dequeue(other);
+        page.slab.absorb(other.slab);
+        
+        // the header of `other' is gone once its own virtual page is remapped,
+        // which goes last so that the mesh can still be undone before
+        void* aliases[maxMeshAliases];
+        std::uint32_t numAliases = 0;
+        for (std::uint32_t i = 0; i < other.numAliases; ++i) {
+            aliases[numAliases++] = other.aliases[i];
+        }
+        aliases[numAliases++] = &other;
+        auto fileOffset = other.fileOffset;
+        auto used = other.used;
+        
+        for (std::uint32_t i = 0; i < numAliases; ++i) {
+            if (vmMapPageFile(m_pageFile, page.fileOffset, vmPageSize(), aliases[i]) != aliases[i]) {
+                // mapping the pages back doesn't take new mappings, they were
+                // split off already
+                for (std::uint32_t j = 0; j < i; ++j) {
+                    auto undone = vmMapPageFile(m_pageFile, fileOffset, vmPageSize(), aliases[j]);
+                    assert(undone == aliases[j]);
+                    (void)undone;
+                }
+                page.numAliases -= i;
+                page.slab.disown(other.slab);
+                enqueue(other, queueOf(other));
+                return false;
+            }
+            page.aliases[page.numAliases++] = aliases[i];
+        }
+        // threads which looked `other' up before the remap freed into its own
+        // physical page, which stays in the file until it is punched
+        if (auto old = static_cast<Page*>(vmMapPageFile(m_pageFile, fileOffset, vmPageSize()))) {
+            for (auto p = old->threadFree.exchange(nullptr, std::memory_order_acquire); p; --used) {
+                auto offset = pointerDistanceTo(pageOf(p), p);
+                p = *reinterpret_cast<void**>(pointerAdd(old, offset));
+                page.slab.free(pointerAdd(&page, offset));
+            }
+            vmDeallocate(old, vmPageSize());
+        }
+        vmPunchPageFile(m_pageFile, fileOffset, vmPageSize());
+        m_freeFileOffsets.push_back(fileOffset);
+        --m_pageCount;
+        
+        page.used += used;
+        requeue(page);
+        return true;
+    }
+    
+    std::size_t queueOf(const Page& page) const
+    {
+        auto capacity = page.slab.capacity();
+        if (!page.used) {
+            return 0;
+        }
+        if (page.used >= capacity) {
+            return fullQueue;
+        }
+        return 1 + page.used * numPartialQueues / capacity;
+    }
+    
+    void enqueue(Page& page, std::size_t queue)
+    {
+        auto capacity = page.slab.capacity();
+        page.queue = static_cast<std::uint32_t>(queue);
+        // the usage range mapping to the queue, inverse of queueOf
+        if (queue == 0) {
+            page.queueLow = 0;
+            page.queueHigh = 1;
+        } else if (queue == fullQueue) {
+            page.queueLow = static_cast<std::uint32_t>(capacity);
+            page.queueHigh = std::numeric_limits<std::uint32_t>::max();
+        } else {
+            page.queueLow = static_cast<std::uint32_t>(
+                std::max<std::size_t>(1, ((queue - 1) * capacity + numPartialQueues - 1) / numPartialQueues));
+            page.queueHigh = static_cast<std::uint32_t>(
+                std::min(capacity, (queue * capacity + numPartialQueues - 1) / numPartialQueues));
+        }
+        m_pageQueues[page.bin][queue].addFirst(page);
+        m_nonEmptyQueues[page.bin] |= 1u << queue;
+    }
+    
+    void dequeue(Page& page)
+    {
+        auto& list = m_pageQueues[page.bin][page.queue];
+        list.remove(page);
+        if (list.empty()) {
+            m_nonEmptyQueues[page.bin] &= ~(1u << page.queue);
+        }
+    }
+    
+    std::size_t binIndex(std::size_t size) const
+    {
+        auto bin = m_sizeClasses.classOf(size);
+        return bin < m_numBins ? bin : MaxBins;
+    }
+    
+    std::size_t binSize(std::size_t bin) const
+    {
+        return Slab::adjustBlockSize(m_sizeClasses.classSize(bin));
+    }
+    
+    static Page* pageOf(const void* p)
+    {
+        return alignedCast<Page*>(roundDownPowerOfTwo(const_cast<void*>(p), vmPageSize()));
+    }
+    
+    List<Page> m_pageQueues[MaxBins][numQueues];
+    // bit i is set if queue i of the bin has a page
+    std::uint32_t m_nonEmptyQueues[MaxBins] = {};
+    std::size_t m_pageCount = 0;
+    // the color of the next page mapped for each bin
+    std::uint32_t m_nextColors[MaxBins] = {};
+    SizeClasses m_sizeClasses;
+    // the classes whose blocks fit a page, requests for the larger ones fail
+    std::size_t m_numBins = 0;
+    // the backing of the pages when meshing is enabled
+    int m_pageFile = -1;
+    std::size_t m_pageFileSize = 0;
+    std::vector<std::size_t> m_freeFileOffsets;
+    std::size_t m_meshPeriod = 0;
+    std::size_t m_freesSinceMesh = 0;
+    AbandonedPool* m_abandonedPool = nullptr;
+    ReadyPages m_readyPages[MaxBins];
+    std::thread m_reserveThread;
+    std::mutex m_reserveMutex;
+    std::condition_variable m_reserveWakeup;
+    bool m_stopReserving = false;
 };
 
 } // namespace memory
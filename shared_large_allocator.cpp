@@ -0,0 +1,162 @@
+//
+//  shared_large_allocator.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "shared_large_allocator.h"
+#include "os_memory.h"
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <new>
+
+#include <pthread.h>
+
+namespace memory
+{
+
+// lies at the start of the shared memory, the heap follows it
+struct SharedLargeAllocator::Header
+{
+    // set last, once the heap is laid out
+    std::atomic<std::uint64_t> magic;
+    std::uint64_t size;
+    std::uint64_t minBlockSize;
+    pthread_mutex_t mutex;
+    // set if a process died holding the mutex and the heap couldn't be recovered
+    std::uint32_t damaged;
+
+    char* heap() { return reinterpret_cast<char*>(this + 1); }
+    char* end() { return reinterpret_cast<char*>(this) + size; }
+};
+
+namespace
+{
+
+constexpr std::uint64_t heapMagic = 0x7368617265646870;
+
+// whether the links can span a heap of `size' bytes following the header
+bool fitsLinks(std::size_t size, std::size_t headerSize)
+{
+    return size >= headerSize && size - headerSize <= CompressedLinks::maxDistance;
+}
+
+} // namespace
+
+// Repairs the heap if the previous owner of the mutex died in the middle of a call.
+class SharedLargeAllocator::Lock
+{
+public:
+    explicit Lock(SharedLargeAllocator& heap)
+        : m_mutex(heap.m_header->mutex)
+    {
+        auto res = pthread_mutex_lock(&m_mutex);
+        assert(!res || res == EOWNERDEAD);
+        if (res == EOWNERDEAD) {
+            pthread_mutex_consistent(&m_mutex);
+            if (!heap.m_allocator.recover()) {
+                heap.m_header->damaged = true;
+            }
+        }
+        m_usable = !heap.m_header->damaged;
+    }
+
+    ~Lock()
+    {
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    Lock(const Lock&) = delete;
+    Lock& operator =(const Lock&) = delete;
+
+    // false if the heap was damaged beyond recovery, nothing may touch it then
+    bool usable() const { return m_usable; }
+private:
+    pthread_mutex_t& m_mutex;
+    bool m_usable;
+};
+
+SharedLargeAllocator::SharedLargeAllocator(void* p, std::size_t size, std::size_t minBlockSize)
+    : SharedLargeAllocator(new (p) Header, CompressedLargeAllocator::attach(p, p))
+{
+    assert(reinterpret_cast<std::uintptr_t>(p) % vmPageSize() == 0);
+    m_header->magic.store(0, std::memory_order_relaxed);
+    if (!fitsLinks(size, sizeof(Header))) {
+        m_header = nullptr;
+        return;
+    }
+    m_header->size = size;
+    m_header->minBlockSize = minBlockSize;
+    m_header->damaged = false;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    // a process dying with the mutex held doesn't leave the others waiting forever
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&m_header->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    m_allocator = CompressedLargeAllocator(m_header->heap(), m_header->end(), minBlockSize);
+    m_header->magic.store(heapMagic, std::memory_order_release);
+}
+
+SharedLargeAllocator::SharedLargeAllocator(Header* header, CompressedLargeAllocator&& allocator)
+    : m_header(header)
+    , m_allocator(std::move(allocator))
+{
+}
+
+SharedLargeAllocator SharedLargeAllocator::attach(void* p, std::size_t size)
+{
+    auto header = static_cast<Header*>(p);
+    if (!fitsLinks(size, sizeof(Header)) || header->magic.load(std::memory_order_acquire) != heapMagic ||
+        header->size != size) {
+        return { nullptr, CompressedLargeAllocator::attach(p, p) };
+    }
+    return { header, CompressedLargeAllocator::attach(header->heap(), header->end(), header->minBlockSize) };
+}
+
+void* SharedLargeAllocator::malloc(std::size_t size, std::size_t alignment)
+{
+    assert(valid());
+    Lock lock(*this);
+    return lock.usable() ? m_allocator.malloc(size, alignment) : nullptr;
+}
+
+void* SharedLargeAllocator::calloc(std::size_t count, std::size_t size, std::size_t alignment)
+{
+    assert(valid());
+    Lock lock(*this);
+    return lock.usable() ? m_allocator.calloc(count, size, alignment) : nullptr;
+}
+
+void SharedLargeAllocator::free(void* p)
+{
+    if (p) {
+        assert(valid() && owns(p));
+        Lock lock(*this);
+        if (lock.usable()) {
+            m_allocator.free(p);
+        }
+    }
+}
+
+std::size_t SharedLargeAllocator::offsetOf(const void* p) const
+{
+    assert(owns(p));
+    return static_cast<const char*>(p) - reinterpret_cast<const char*>(m_header);
+}
+
+void* SharedLargeAllocator::at(std::size_t offset) const
+{
+    assert(offset < m_header->size);
+    return reinterpret_cast<char*>(m_header) + offset;
+}
+
+} // namespace memory
@@ -0,0 +1,74 @@
+//
+//  shared_large_allocator.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef SHARED_LARGE_ALLOCATOR_H
+#define SHARED_LARGE_ALLOCATOR_H
+
+#include "large_allocator.h"
+
+#include <cstddef>
+
+namespace memory
+{
+
+// A heap in memory shared between processes, e.g. a mapping of
+// vmCreatePageFile() or shm_open(). Everything it keeps lies in the shared
+// memory and links by offsets, so each process may map it at a different
+// address, and a process shared mutex guards it. A block is handed to another
+// process as its offset from the start of the memory. Heaps of up to 4 GiB.
+//
+// The mutex is robust, the next process to take it after one died holding it
+// recovers the heap. If that fails, every malloc() fails from then on and
+// free() does nothing.
+//
+//     auto file = memory::vmCreatePageFile();
+//     memory::vmResizePageFile(file, size);
+//     memory::SharedLargeAllocator heap(memory::vmMapPageFile(file, 0, size), size);
+//     ...
+//     // in another process with the file
+//     auto heap = memory::SharedLargeAllocator::attach(memory::vmMapPageFile(file, 0, size), size);
+class SharedLargeAllocator
+{
+public:
+    // lays a new heap out over the `size' bytes at `p', which have to be page
+    // aligned, the allocator isn't valid() if the heap can't span them
+    SharedLargeAllocator(void* p, std::size_t size, std::size_t minBlockSize = 0);
+
+    // attaches to the heap laid out over the same memory, mapped at `p' now,
+    // the allocator isn't valid() if there is none
+    static SharedLargeAllocator attach(void* p, std::size_t size);
+
+    SharedLargeAllocator(SharedLargeAllocator&&) = default;
+    SharedLargeAllocator& operator =(SharedLargeAllocator&&) = default;
+
+    bool valid() const { return m_header; }
+
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void* calloc(std::size_t count, std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void free(void* p);
+
+    std::size_t usableSize(const void* p) const { return m_allocator.usableSize(p); }
+    bool owns(const void* p) const { return m_allocator.owns(p); }
+
+    // where `p' lies in the shared memory, the same for every process
+    std::size_t offsetOf(const void* p) const;
+    // the address of `offset' in the mapping of this process
+    void* at(std::size_t offset) const;
+private:
+    struct Header;
+    class Lock;
+
+    SharedLargeAllocator(Header* header, CompressedLargeAllocator&& allocator);
+
+    Header* m_header;
+    CompressedLargeAllocator m_allocator;
+};
+
+} // namespace memory
+
+#endif /* SHARED_LARGE_ALLOCATOR_H */
@@ -0,0 +1,209 @@
+//
+//  size_class_gen.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+//  Picks at most K size classes minimizing the expected internal fragmentation
+//  for an allocation size histogram, and prints a header with a constexpr class
+//  table which can be used as the SizeClasses of SegregatedAllocator.
+//
+//  usage: size_class_gen <histogram> <max classes> [name] [granularity] [page size]
+//
+//  Every line of the histogram is `size [count]', a missing count means 1, so
+//  a plain trace of request sizes works as well. Lines starting with # are ignored.
+//  No class is larger than a quarter of the page size, 4096 by default, so that
+//  the pages of SegregatedAllocator hold a few blocks of every class. The larger
+//  requests are left to the allocator behind it.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+
+using namespace std;
+
+namespace
+{
+    
+struct Bucket
+{
+    size_t size;
+    uint64_t count;
+};
+
+// the sizes are rounded up to the granularity first
+vector<Bucket> readHistogram(istream& in, size_t granularity)
+{
+    map<size_t, uint64_t> counts;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream fields(line);
+        size_t size;
+        uint64_t count = 1;
+        if (!(fields >> size)) {
+            continue;
+        }
+        fields >> count;
+        size = (max<size_t>(size, 1) + granularity - 1) / granularity * granularity;
+        counts[size] += count;
+    }
+    
+    vector<Bucket> buckets;
+    for (auto& e : counts) {
+        buckets.push_back({ e.first, e.second });
+    }
+    return buckets;
+}
+
+// returns the chosen class sizes, the largest size always gets a class
+vector<size_t> solve(const vector<Bucket>& buckets, size_t maxClasses, double& waste)
+{
+    auto n = buckets.size();
+    // prefix sums of counts and of count * size
+    vector<double> counts(n + 1), bytes(n + 1);
+    for (size_t i = 0; i < n; ++i) {
+        counts[i + 1] = counts[i] + buckets[i].count;
+        bytes[i + 1] = bytes[i] + double(buckets[i].count) * buckets[i].size;
+    }
+    // waste of serving buckets [i, j] with a class of size buckets[j].size
+    auto cost = [&](size_t i, size_t j) {
+        return buckets[j].size * (counts[j + 1] - counts[i]) - (bytes[j + 1] - bytes[i]);
+    };
+    
+    auto k = min(maxClasses, n);
+    const auto inf = numeric_limits<double>::infinity();
+    // best[c][j]: minimal waste of buckets [0, j] using c + 1 classes, the last one at j
+    vector<vector<double>> best(k, vector<double>(n, inf));
+    vector<vector<size_t>> from(k, vector<size_t>(n, 0));
+    for (size_t j = 0; j < n; ++j) {
+        best[0][j] = cost(0, j);
+    }
+    for (size_t c = 1; c < k; ++c) {
+        for (size_t j = c; j < n; ++j) {
+            for (size_t i = c - 1; i < j; ++i) {
+                auto w = best[c - 1][i] + cost(i + 1, j);
+                if (w < best[c][j]) {
+                    best[c][j] = w;
+                    from[c][j] = i;
+                }
+            }
+        }
+    }
+    
+    size_t classes = 0;
+    for (size_t c = 1; c < k; ++c) {
+        if (best[c][n - 1] < best[classes][n - 1]) {
+            classes = c;
+        }
+    }
+    waste = best[classes][n - 1];
+    
+    vector<size_t> sizes(classes + 1);
+    for (size_t c = classes + 1, j = n - 1; c-- > 0; ) {
+        sizes[c] = buckets[j].size;
+        j = from[c][j];
+    }
+    return sizes;
+}
+
+void writeHeader(ostream& out, const string& name, const vector<size_t>& sizes,
+                 size_t granularity, double waste, double requested)
+{
+    auto lookupSize = sizes.back() / granularity + 1;
+    auto indexType = sizes.size() < 256 ? "std::uint8_t" : "std::uint16_t";
+    
+    out << "//\n"
+        << "//  generated by size_class_gen, do not edit\n"
+        << "//\n"
+        << "//  expected internal fragmentation: " << (requested ? waste / requested * 100 : 0) << "%\n"
+        << "//\n\n"
+        << "#pragma once\n\n"
+        << "#include <cstddef>\n"
+        << "#include <cstdint>\n\n"
+        << "namespace memory\n{\n\n"
+        << "struct " << name << "\n{\n"
+        << "    static constexpr std::size_t granularity = " << granularity << ";\n"
+        << "    static constexpr std::size_t sizes[] = {";
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        out << (i % 8 ? " " : "\n        ") << sizes[i] << ",";
+    }
+    out << "\n    };\n"
+        << "    // class index of every size divided by the granularity, rounded up\n"
+        << "    static constexpr " << indexType << " lookup[] = {";
+    size_t cls = 0;
+    for (size_t i = 0; i < lookupSize; ++i) {
+        while (sizes[cls] < i * granularity) {
+            ++cls;
+        }
+        out << (i % 16 ? " " : "\n        ") << cls << ",";
+    }
+    out << "\n    };\n\n"
+        << "    static constexpr std::size_t count() { return " << sizes.size() << "; }\n\n"
+        << "    static constexpr std::size_t classOf(std::size_t size)\n"
+        << "    {\n"
+        << "        auto index = (size + granularity - 1) / granularity;\n"
+        << "        return index < sizeof(lookup) / sizeof(lookup[0]) ? lookup[index] : count();\n"
+        << "    }\n\n"
+        << "    static constexpr std::size_t classSize(std::size_t index) { return sizes[index]; }\n"
+        << "};\n\n"
+        << "} // namespace memory\n";
+}
+    
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " <histogram> <max classes> [name] [granularity] [page size]\n";
+        return 1;
+    }
+    
+    ifstream in(argv[1]);
+    if (!in) {
+        cerr << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    auto maxClasses = strtoul(argv[2], nullptr, 10);
+    string name = argc > 3 ? argv[3] : "GeneratedSizeClasses";
+    size_t granularity = argc > 4 ? strtoul(argv[4], nullptr, 10) : 8;
+    size_t pageSize = argc > 5 ? strtoul(argv[5], nullptr, 10) : 4096;
+    auto maxSize = pageSize / 4 / granularity * granularity;
+    if (!maxClasses || !granularity || !maxSize) {
+        cerr << "the number of classes and the granularity must be positive, the granularity at most a quarter of the page size\n";
+        return 1;
+    }
+    
+    auto buckets = readHistogram(in, granularity);
+    uint64_t dropped = 0;
+    while (!buckets.empty() && buckets.back().size > maxSize) {
+        dropped += buckets.back().count;
+        buckets.pop_back();
+    }
+    if (dropped) {
+        cerr << dropped << " requests larger than " << maxSize << " bytes get no class\n";
+    }
+    if (buckets.empty()) {
+        cerr << "empty histogram\n";
+        return 1;
+    }
+    
+    double requested = 0;
+    for (auto& b : buckets) {
+        requested += double(b.count) * b.size;
+    }
+    double waste;
+    auto sizes = solve(buckets, maxClasses, waste);
+    writeHeader(cout, name, sizes, granularity, waste, requested);
+}
@@ -0,0 +1,55 @@
+//
+//  size_classes.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef SIZE_CLASSES_H
+#define SIZE_CLASSES_H
+
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+
+namespace memory
+{
+    
+// Maps request sizes to size classes for SegregatedAllocator. Any type with the
+// same interface can be used instead, e.g. a table generated by size_class_gen.
+//
+// The classes are minSize, minSize + step, minSize + 2 * step, ...
+class LinearSizeClasses
+{
+public:
+    LinearSizeClasses(std::size_t minSize, std::size_t step, std::size_t count)
+        : m_minSize(minSize)
+        , m_step(step)
+        , m_count(count)
+    {
+        assert(minSize > 0 && step > 0 && count > 0);
+    }
+    
+    std::size_t count() const { return m_count; }
+    
+    // index of the smallest class which can hold `size', count() if there is none
+    std::size_t classOf(std::size_t size) const
+    {
+        return std::min((std::max(size, m_minSize) - m_minSize + m_step - 1) / m_step, m_count);
+    }
+    
+    std::size_t classSize(std::size_t index) const
+    {
+        assert(index < m_count);
+        return m_minSize + index * m_step;
+    }
+private:
+    std::size_t m_minSize;
+    std::size_t m_step;
+    std::size_t m_count;
+};
+
+} // namespace memory
+
+#endif /* SIZE_CLASSES_H */
@@ -0,0 +1,138 @@
+//
+//  striped_large_allocator.cpp
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#include "striped_large_allocator.h"
+#include "os_memory.h"
+#include "memory_utils.h"
+#include "trace_path.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace memory
+{
+    
+StripedLargeAllocator::Arena::Arena(char* beg, char* end, std::size_t minBlockSize)
+    // fresh mappings are zero filled
+    : allocator(beg, end, minBlockSize, true)
+    , beg(beg)
+    , end(end)
+{
+}
+    
+StripedLargeAllocator::StripedLargeAllocator(std::size_t numArenas, std::size_t arenaSize, std::size_t minBlockSize)
+    : m_arenaSize(roundUpPowerOfTwo(arenaSize, vmPageSize()))
+{
+    assert(numArenas && arenaSize);
+    for (std::size_t i = 0; i < numArenas; ++i) {
+        auto beg = static_cast<char*>(vmAllocate(m_arenaSize));
+        // make do with the arenas mapped so far
+        if (!beg) {
+            break;
+        }
+        m_arenas.push_back(std::make_unique<Arena>(beg, beg + m_arenaSize, minBlockSize));
+        m_byAddress.push_back(m_arenas.back().get());
+    }
+    std::sort(m_byAddress.begin(), m_byAddress.end(), [](const Arena* a, const Arena* b) {
+        return a->beg < b->beg;
+    });
+}
+    
+StripedLargeAllocator::~StripedLargeAllocator()
+{
+    for (auto& arena : m_arenas) {
+        vmDeallocate(arena->beg, m_arenaSize);
+    }
+}
+    
+void* StripedLargeAllocator::malloc(std::size_t size, std::size_t alignment)
+{
+    return allocate([&](LargeAllocator& allocator) {
+        return allocator.malloc(size, alignment);
+    });
+}
+    
+void* StripedLargeAllocator::calloc(std::size_t count, std::size_t size, std::size_t alignment)
+{
+    return allocate([&](LargeAllocator& allocator) {
+        return allocator.calloc(count, size, alignment);
+    });
+}
+    
+void StripedLargeAllocator::free(void* p)
+{
+    if (p) {
+        auto arena = arenaOf(p);
+        assert(arena);
+        std::lock_guard<std::mutex> lock(arena->mutex);
+        arena->allocator.free(p);
+    }
+}
+    
+std::size_t StripedLargeAllocator::usableSize(const void* p) const
+{
+    // only the header of the block is read, which nobody else changes while it's allocated
+    return arenaOf(p)->allocator.usableSize(p);
+}
+    
+bool StripedLargeAllocator::owns(const void* p) const
+{
+    return arenaOf(p) != nullptr;
+}
+    
+template<typename Alloc>
+void* StripedLargeAllocator::allocate(Alloc&& alloc)
+{
+    auto numArenas = m_arenas.size();
+    if (!numArenas) {
+        return nullptr;
+    }
+    auto first = preferredArena();
+    // skip the arenas somebody else is using
+    for (std::size_t i = 0; i < numArenas; ++i) {
+        auto& arena = *m_arenas[(first + i) % numArenas];
+        if (arena.mutex.try_lock()) {
+            std::lock_guard<std::mutex> lock(arena.mutex, std::adopt_lock);
+            if (auto p = alloc(arena.allocator)) {
+                return p;
+            }
+        }
+    }
+    // all of them are busy or full, wait for them in turn
+    MEMORY_TRACE_PATH(stripedContended);
+    for (std::size_t i = 0; i < numArenas; ++i) {
+        auto& arena = *m_arenas[(first + i) % numArenas];
+        std::lock_guard<std::mutex> lock(arena.mutex);
+        if (auto p = alloc(arena.allocator)) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+    
+StripedLargeAllocator::Arena* StripedLargeAllocator::arenaOf(const void* p) const
+{
+    auto it = std::upper_bound(m_byAddress.begin(), m_byAddress.end(), p, [](const void* p, const Arena* arena) {
+        return p < arena->beg;
+    });
+    if (it == m_byAddress.begin()) {
+        return nullptr;
+    }
+    auto arena = *--it;
+    return p < arena->end ? arena : nullptr;
+}
+    
+std::size_t StripedLargeAllocator::preferredArena() const
+{
+    // threads are numbered in the order they first allocate
+    static std::atomic<std::size_t> nextThread{ 0 };
+    thread_local std::size_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+    return thread % m_arenas.size();
+}
+    
+} // namespace memory
@@ -0,0 +1,66 @@
+//
+//  striped_large_allocator.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef STRIPED_LARGE_ALLOCATOR_H
+#define STRIPED_LARGE_ALLOCATOR_H
+
+#include "large_allocator.h"
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+
+namespace memory
+{
+    
+// Thread safe front end over several LargeAllocator arenas, each with its own
+// lock. Threads are spread over the arenas round robin and move on to an
+// uncontended arena when theirs is busy. A block is freed to the arena whose
+// range contains it.
+class StripedLargeAllocator
+{
+public:
+    StripedLargeAllocator(std::size_t numArenas, std::size_t arenaSize, std::size_t minBlockSize = 0);
+    ~StripedLargeAllocator();
+    
+    StripedLargeAllocator(const StripedLargeAllocator&) = delete;
+    StripedLargeAllocator& operator =(const StripedLargeAllocator&) = delete;
+    
+    void* malloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void* calloc(std::size_t count, std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void free(void* p);
+    
+    std::size_t usableSize(const void* p) const;
+    bool owns(const void* p) const;
+private:
+    struct Arena
+    {
+        Arena(char* beg, char* end, std::size_t minBlockSize);
+        
+        std::mutex mutex;
+        LargeAllocator allocator;
+        char* beg;
+        char* end;
+    };
+    
+    template<typename Alloc>
+    void* allocate(Alloc&& alloc);
+    Arena* arenaOf(const void* p) const;
+    std::size_t preferredArena() const;
+    
+    std::vector<std::unique_ptr<Arena>> m_arenas;
+    // the arenas ordered by address
+    std::vector<Arena*> m_byAddress;
+    std::size_t m_arenaSize;
+};
+
+} // namespace memory
+
+#endif /* STRIPED_LARGE_ALLOCATOR_H */
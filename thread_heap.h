@@ -0,0 +1,113 @@
+//
+//  thread_heap.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef THREAD_HEAP_H
+#define THREAD_HEAP_H
+
+#include <cstddef>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace memory
+{
+    
+// One SegregatedAllocator per thread, created on first use. Blocks may be freed
+// by any thread. When a thread exits the pages its heap still uses are
+// abandoned, and the heaps of the other threads adopt them on their next page
+// miss instead of mapping new pages. The ThreadHeaps must outlive the threads
+// using it.
+template<typename Allocator>
+class ThreadHeaps
+{
+public:
+    // `args' are passed to the constructor of every heap
+    template<typename... Args>
+    explicit ThreadHeaps(Args... args)
+        : m_create([args...] { return std::make_unique<Allocator>(args...); })
+    {
+    }
+    
+    ThreadHeaps(const ThreadHeaps&) = delete;
+    ThreadHeaps& operator =(const ThreadHeaps&) = delete;
+    
+    // the heap of the destroying thread goes away with the pool
+    ~ThreadHeaps()
+    {
+        localHeaps().remove(*this);
+    }
+    
+    // the heap of the calling thread
+    Allocator& local()
+    {
+        return localHeaps().get(*this);
+    }
+    
+    void* malloc(std::size_t size) { return local().malloc(size); }
+    void* calloc(std::size_t count, std::size_t size) { return local().calloc(count, size); }
+    void free(void* p) { local().free(p); }
+    void freeBatch(void* const* blocks, std::size_t count) { local().freeBatch(blocks, count); }
+    std::size_t usableSize(const void* p) { return local().usableSize(p); }
+private:
+    // the heaps of a thread, abandoned when the thread exits
+    class LocalHeaps
+    {
+    public:
+        ~LocalHeaps()
+        {
+            for (auto& e : m_heaps) {
+                e.second->abandon();
+            }
+        }
+        
+        Allocator& get(ThreadHeaps& owner)
+        {
+            if (m_last && m_last->first == &owner) {
+                return *m_last->second;
+            }
+            for (auto& e : m_heaps) {
+                if (e.first == &owner) {
+                    m_last = &e;
+                    return *e.second;
+                }
+            }
+            
+            auto heap = owner.m_create();
+            heap->setAbandonedPool(&owner.m_pool);
+            m_heaps.emplace_back(&owner, std::move(heap));
+            m_last = &m_heaps.back();
+            return *m_last->second;
+        }
+        
+        void remove(ThreadHeaps& owner)
+        {
+            m_last = nullptr;
+            m_heaps.erase(std::remove_if(m_heaps.begin(), m_heaps.end(), [&](auto& e) {
+                return e.first == &owner;
+            }), m_heaps.end());
+        }
+    private:
+        std::vector<std::pair<ThreadHeaps*, std::unique_ptr<Allocator>>> m_heaps;
+        std::pair<ThreadHeaps*, std::unique_ptr<Allocator>>* m_last = nullptr;
+    };
+    
+    static LocalHeaps& localHeaps()
+    {
+        thread_local LocalHeaps heaps;
+        return heaps;
+    }
+    
+    std::function<std::unique_ptr<Allocator>()> m_create;
+    typename Allocator::AbandonedPool m_pool;
+};
+
+} // namespace memory
+
+#endif /* THREAD_HEAP_H */
@@ -0,0 +1,70 @@
+//
+//  trace_path.h
+//  memoryallocator
+//
+//  Created by ashen on 2026/10/18.
+//  Copyright © 2026 ashen. All rights reserved.
+//
+
+#ifndef TRACE_PATH_H
+#define TRACE_PATH_H
+
+#include <cstdint>
+
+namespace memory
+{
+
+// The slow paths a call may take inside an allocator. MEMORY_TRACE_PATH(path)
+// marks one, and compiles to nothing unless MEMORY_TRACE_PATHS is defined, in
+// which case it sets the bit of the path in tracedPaths of the calling thread.
+// A harness clears it before a call and reads it after, to tell which paths
+// the slow calls went through.
+enum class TracePath : unsigned {
+    osMap,
+    osUnmap,
+    segregatedNewPage,
+    segregatedReadyPage,
+    segregatedReclaim,
+    segregatedReleasePage,
+    segregatedMesh,
+    largeSplit,
+    largeCoalesce,
+    largeNoFit,
+    buddySplit,
+    buddyMerge,
+    stripedContended,
+    count
+};
+
+inline const char* tracePathName(TracePath path)
+{
+    static const char* const names[] = {
+        "osMap",
+        "osUnmap",
+        "segregatedNewPage",
+        "segregatedReadyPage",
+        "segregatedReclaim",
+        "segregatedReleasePage",
+        "segregatedMesh",
+        "largeSplit",
+        "largeCoalesce",
+        "largeNoFit",
+        "buddySplit",
+        "buddyMerge",
+        "stripedContended",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<unsigned>(TracePath::count));
+    return names[static_cast<unsigned>(path)];
+}
+
+#ifdef MEMORY_TRACE_PATHS
+inline thread_local std::uint32_t tracedPaths = 0;
+#  define MEMORY_TRACE_PATH(path) \
+    (::memory::tracedPaths |= 1u << static_cast<unsigned>(::memory::TracePath::path))
+#else
+#  define MEMORY_TRACE_PATH(path) ((void)0)
+#endif
+
+} // namespace memory
+
+#endif /* TRACE_PATH_H */